@@ -0,0 +1,231 @@
+#include "assets.h"
+#include <string.h>
+#include "esp_partition.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "Assets";
+
+/* Image made by utils/pack_assets.py */
+#define ASSETS_PARTITION "assets"
+#define ASSETS_MAGIC "BPAK"
+#define ASSETS_VERSION 1
+#define ASSETS_PATH_SIZE 48
+#define ASSETS_FLAG_LZ 1
+
+typedef struct
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t entryCount;
+    uint32_t dataOffset;
+    uint32_t totalSize;
+} assets_header_t;
+
+typedef struct
+{
+    char path[ASSETS_PATH_SIZE];
+    uint32_t offset;
+    uint32_t size;
+    uint32_t flags;
+    uint32_t rawSize;
+} assets_entry_t;
+
+_Static_assert(sizeof(assets_header_t) == 16, "assets header must match utils/pack_assets.py");
+_Static_assert(sizeof(assets_entry_t) == 64, "assets entry must match utils/pack_assets.py");
+
+/* The whole partition stays mapped, lookups hand out pointers into it */
+static esp_partition_mmap_handle_t vgc_assets_mmap_handle;
+static const uint8_t *vgc_assets_image = NULL;
+static const assets_entry_t *vgc_assets_entries = NULL;
+static int vgc_assets_entry_count = 0;
+
+esp_err_t vgc_assets_init()
+{
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, ASSETS_PARTITION);
+    if (partition == NULL)
+    {
+        ESP_LOGE(TAG, "No %s partition", ASSETS_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const void *image = NULL;
+    esp_err_t err = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &image, &vgc_assets_mmap_handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to map assets (%s)", esp_err_to_name(err));
+        return err;
+    }
+
+    // Check the index before handing out anything that points into it
+    const assets_header_t *header = image;
+    if (memcmp(header->magic, ASSETS_MAGIC, 4) != 0 || header->version != ASSETS_VERSION || header->totalSize > partition->size ||
+        sizeof(assets_header_t) + header->entryCount * sizeof(assets_entry_t) > header->dataOffset)
+    {
+        ESP_LOGE(TAG, "No valid asset image in the %s partition, flash it with idf.py flash", ASSETS_PARTITION);
+        esp_partition_munmap(vgc_assets_mmap_handle);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const assets_entry_t *entries = (const assets_entry_t *)(header + 1);
+    for (int i = 0; i < header->entryCount; i++)
+    {
+        if (entries[i].offset > header->totalSize || entries[i].size > header->totalSize - entries[i].offset)
+        {
+            ESP_LOGE(TAG, "Asset %.*s is out of bounds", ASSETS_PATH_SIZE, entries[i].path);
+            esp_partition_munmap(vgc_assets_mmap_handle);
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+    vgc_assets_image = image;
+    vgc_assets_entries = entries;
+    vgc_assets_entry_count = header->entryCount;
+
+    ESP_LOGI(TAG, "Mapped %d assets, %" PRIu32 " bytes", vgc_assets_entry_count, header->totalSize);
+
+    return ESP_OK;
+}
+
+esp_err_t vgc_assets_deinit()
+{
+    if (vgc_assets_image != NULL)
+    {
+        esp_partition_munmap(vgc_assets_mmap_handle);
+        vgc_assets_image = NULL;
+        vgc_assets_entries = NULL;
+        vgc_assets_entry_count = 0;
+    }
+
+    return ESP_OK;
+}
+
+static const assets_entry_t *vgc_assets_find(const char *path)
+{
+    // The packer sorts the index by path
+    int low = 0;
+    int high = vgc_assets_entry_count - 1;
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        int order = strncmp(path, vgc_assets_entries[mid].path, ASSETS_PATH_SIZE);
+        if (order == 0)
+        {
+            return &vgc_assets_entries[mid];
+        }
+        if (order > 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    ESP_LOGE(TAG, "Asset not found: %s", path);
+    return NULL;
+}
+
+bool vgc_assets_get(const char *path, const uint8_t **data, size_t *length)
+{
+    const assets_entry_t *entry = vgc_assets_find(path);
+    if (entry == NULL)
+    {
+        return false;
+    }
+
+    if (entry->flags & ASSETS_FLAG_LZ)
+    {
+        ESP_LOGE(TAG, "Asset %s is compressed, it can't be used in place", path);
+        return false;
+    }
+
+    *data = vgc_assets_image + entry->offset;
+    *length = entry->size;
+    return true;
+}
+
+bool vgc_assets_open(const char *path, vgc_asset_reader_t *reader)
+{
+    const assets_entry_t *entry = vgc_assets_find(path);
+    if (entry == NULL)
+    {
+        return false;
+    }
+
+    reader->data = vgc_assets_image + entry->offset;
+    reader->size = entry->size;
+    reader->rawSize = (entry->flags & ASSETS_FLAG_LZ) ? entry->rawSize : entry->size;
+    reader->pos = 0;
+    reader->decoder = NULL;
+
+    if (entry->flags & ASSETS_FLAG_LZ)
+    {
+        // The decoder window is touched for every byte, keep it in internal RAM
+        reader->decoder = heap_caps_malloc(sizeof(lz_decoder_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (reader->decoder == NULL)
+        {
+            ESP_LOGE(TAG, "Failed to allocate memory for decompressing %s", path);
+            return false;
+        }
+        lz_decoder_init(reader->decoder, reader->data, reader->size);
+    }
+
+    return true;
+}
+
+int vgc_assets_read(vgc_asset_reader_t *reader, void *dst, size_t capacity)
+{
+    // Never more than the asset holds, even if the compressed data says otherwise
+    if (capacity > reader->rawSize - reader->pos)
+    {
+        capacity = reader->rawSize - reader->pos;
+    }
+
+    int count;
+    if (reader->decoder != NULL)
+    {
+        count = lz_decoder_read(reader->decoder, dst, capacity);
+        if (count < 0)
+        {
+            ESP_LOGE(TAG, "Compressed asset is corrupt");
+            return -1;
+        }
+    }
+    else
+    {
+        memcpy(dst, reader->data + reader->pos, capacity);
+        count = capacity;
+    }
+
+    reader->pos += count;
+    return count;
+}
+
+void vgc_assets_close(vgc_asset_reader_t *reader)
+{
+    if (reader->decoder != NULL)
+    {
+        heap_caps_free(reader->decoder);
+        reader->decoder = NULL;
+    }
+}
+
+bool vgc_assets_hash(const char *path, uint32_t *hash)
+{
+    const assets_entry_t *entry = vgc_assets_find(path);
+    if (entry == NULL)
+    {
+        return false;
+    }
+
+    const uint8_t *data = vgc_assets_image + entry->offset;
+    uint32_t value = *hash;
+    for (uint32_t i = 0; i < entry->size; i++)
+    {
+        value = (value ^ data[i]) * 0x01000193u;
+    }
+    *hash = value;
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "lz.h"
+
+/* Sequential reader over one asset, decompressing it on the fly when it is stored compressed */
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    size_t rawSize;
+    size_t pos;
+    lz_decoder_t *decoder;
+} vgc_asset_reader_t;
+
+esp_err_t vgc_assets_init();
+esp_err_t vgc_assets_deinit();
+
+/* Look up a packed asset by its path in data/bitsy (e.g. "engine/bitsy.bin").
+   The data is mapped flash: read only, valid until vgc_assets_deinit, no copy made.
+   Compressed assets can't be used in place, read them with vgc_assets_open instead. */
+bool vgc_assets_get(const char *path, const uint8_t **data, size_t *length);
+
+/* Open an asset for reading in chunks of any size; rawSize is its size once decompressed */
+bool vgc_assets_open(const char *path, vgc_asset_reader_t *reader);
+
+/* Returns the number of bytes read, 0 at the end of the asset, or -1 if it is corrupt */
+int vgc_assets_read(vgc_asset_reader_t *reader, void *dst, size_t capacity);
+
+void vgc_assets_close(vgc_asset_reader_t *reader);
+
+/* Continue an FNV-1a hash over an asset as stored, compressed or not, to tell versions apart */
+bool vgc_assets_hash(const char *path, uint32_t *hash);
+
+#endif // ASSETS_H
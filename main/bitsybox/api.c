@@ -6,12 +6,39 @@ static const char *TAG = "BitsyAPI";
 int curGraphicsMode = 0;
 
 int curBufferId = -1;
-int tileStartBufferId = 2;
-int nextBufferId = 2;
+
+// Draw calls made from JS one at a time, reset by log_draw_stats
+int drawCallCount = 0;
+
+// Tiles built during the current update, reported by log_tile_builds
+static int tileBuildCount = 0;
+static int bitmapTileBuildCount = 0;
+
+// Checked by the game loop after every update
+bool isGameOver = false;
 
 int textboxWidth = 104;
 int textboxHeight = 38;
 
+// Content signature of each atlas tile, renewed whenever the tile is drawn into
+static uint32_t tileSignatures[TILE_ATLAS_CAPACITY];
+#define TILE_SIGNATURE(tileId) tileSignatures[(tileId) - TILE_ATLAS_FIRST_ID]
+
+// Opacity of each atlas tile, one byte per row with bit 0 for the first pixel. Pixels of the
+// tile's clear color are transparent; built once when the tile is finished, not per draw.
+static uint8_t tileMasks[TILE_ATLAS_CAPACITY][TILE_SIZE];
+#define TILE_MASK(tileId) tileMasks[(tileId) - TILE_ATLAS_FIRST_ID]
+
+// Palette index the tile was cleared to, -1 while it hasn't been (then the whole tile is opaque)
+static int16_t tileClearIndices[TILE_ATLAS_CAPACITY];
+#define TILE_CLEAR_INDEX(tileId) tileClearIndices[(tileId) - TILE_ATLAS_FIRST_ID]
+
+// Salt so a tile drawn masked and drawn opaque never give a cell the same signature
+#define SPRITE_SIGNATURE(tileId) (~TILE_SIGNATURE(tileId))
+
+// Signature of a screen cleared to a palette index, kept clear of present_new_signature values
+#define CLEAR_SIGNATURE(paletteIndex) (0x80000000u | (paletteIndex))
+
 duk_ret_t bitsy_log(duk_context *ctx)
 {
     const char *printStr;
@@ -62,9 +89,44 @@ duk_ret_t bitsy_get_button(duk_context *ctx)
     return 1;
 }
 
+duk_ret_t bitsy_get_time(duk_context *ctx)
+{
+    // milliseconds with microsecond resolution
+    duk_push_number(ctx, gameClock / 1000.0);
+    return 1;
+}
+
+static void build_tile_mask(int tileId)
+{
+    const bitsy_pixel_t *tile = tile_atlas_pixels(tileId);
+    int clearIndex = TILE_CLEAR_INDEX(tileId);
+    bitsy_pixel_t clearPixel = BITSY_PIXEL(clearIndex < 0 ? 0 : clearIndex);
+
+    for (int y = 0; y < TILE_SIZE; y++) {
+        uint8_t row = 0;
+        for (int x = 0; x < TILE_SIZE; x++) {
+            if (clearIndex < 0 || tile[y * TILE_SIZE + x] != clearPixel) {
+                row |= 1u << x;
+            }
+        }
+        TILE_MASK(tileId)[y] = row;
+    }
+}
+
+uint32_t tile_signature(int tileId)
+{
+    return TILE_SIGNATURE(tileId);
+}
+
+void draw_set_graphics_mode(int mode)
+{
+    curGraphicsMode = mode;
+}
+
 duk_ret_t bitsy_set_graphics_mode(duk_context *ctx)
 {
-    curGraphicsMode = duk_get_int(ctx, 0);
+    drawCallCount++;
+    draw_set_graphics_mode(duk_get_int(ctx, 0));
     return 0;
 }
 
@@ -75,9 +137,19 @@ duk_ret_t bitsy_set_color(duk_context *ctx)
     int g = duk_get_int(ctx, 2);
     int b = duk_get_int(ctx, 3);
 
-    lv_color_t color = lv_color_make(r, g, b);
+    if (paletteIndex < 0 || paletteIndex >= SYSTEM_PALETTE_MAX) {
+        return 0;
+    }
+
+    // Converted to the panel format once here, never per pixel
+    bitsy_color_t color = bitsy_color_make(r, g, b);
 
-    systemPalette[paletteIndex] = color;
+    // Everything on the panel may use this color; with an indexed framebuffer the
+    // next present repaints it without any tile being redrawn
+    if (systemPalette[paletteIndex] != color) {
+        systemPalette[paletteIndex] = color;
+        present_invalidate();
+    }
 
     return 0;
 }
@@ -86,210 +158,342 @@ duk_ret_t bitsy_reset_colors(duk_context *ctx)
 {
     for (int i = 0; i < SYSTEM_PALETTE_MAX; i++)
     {
-        systemPalette[i] = lv_color_black();
+        systemPalette[i] = bitsy_color_make(0, 0, 0);
     }
+    present_invalidate();
     ESP_LOGI(TAG, "Reset colors");
 
     return 0;
 }
 
+void draw_begin(int bufferId)
+{
+    curBufferId = bufferId;
+
+    // The tile is about to change, so screen cells showing it need a new signature
+    if (tile_atlas_contains(curBufferId)) {
+        TILE_SIGNATURE(curBufferId) = present_new_signature();
+    }
+}
+
 duk_ret_t bitsy_draw_begin(duk_context *ctx)
 {
-    curBufferId = duk_get_int(ctx, 0);
+    drawCallCount++;
+    draw_begin(duk_get_int(ctx, 0));
     return 0;
 }
 
-duk_ret_t bitsy_draw_end(duk_context *ctx)
+void draw_end(void)
 {
+    // The tile is finished, its mask stays valid until it's drawn into again
+    if (tile_atlas_contains(curBufferId)) {
+        build_tile_mask(curBufferId);
+    }
+
     curBufferId = -1;
+}
+
+duk_ret_t bitsy_draw_end(duk_context *ctx)
+{
+    drawCallCount++;
+    draw_end();
     return 0;
 }
 
-duk_ret_t bitsy_draw_pixel(duk_context *ctx)
+void draw_pixel(int paletteIndex, int x, int y)
 {
-    int paletteIndex = duk_get_int(ctx, 0);
-    int x = duk_get_int(ctx, 1);
-    int y = duk_get_int(ctx, 2);
+    if (paletteIndex < 0 || paletteIndex >= SYSTEM_PALETTE_MAX || x < 0 || y < 0) {
+        return;
+    }
 
-    lv_color_t color = systemPalette[paletteIndex];
+    bitsy_pixel_t color = BITSY_PIXEL(paletteIndex);
 
     // Apply render scale
     int scaledX = x * RENDER_SCALE;
     int scaledY = y * RENDER_SCALE;
 
     if (curBufferId == 0 && curGraphicsMode == 0) {
-        // Use scaled coordinates
-        for (int i = 0; i < RENDER_SCALE; i++) {
-            for (int j = 0; j < RENDER_SCALE; j++) {
-                drawingBuffers[SCREEN_BUFFER_ID][(scaledY + j) * SCREEN_SIZE + (scaledX + i)] = color;
-            }
+        if (x >= SCREEN_SIZE / RENDER_SCALE || y >= SCREEN_SIZE / RENDER_SCALE) {
+            return;
         }
+
+        // Use scaled coordinates
+        blit_fill_rect(&drawingBuffers[SCREEN_BUFFER_ID][scaledY * SCREEN_SIZE + scaledX], SCREEN_SIZE, color, RENDER_SCALE, RENDER_SCALE);
+        present_mark_dirty(scaledX, scaledY, RENDER_SCALE, RENDER_SCALE);
     }
     else if (curBufferId == 1 && curGraphicsMode == 1) {
+        if (x >= textboxWidth / TEXTBOX_RENDER_SCALE || y >= textboxHeight / TEXTBOX_RENDER_SCALE) {
+            return;
+        }
+
         // Use textboxRenderScale for this buffer
         int scaledTextboxX = x * TEXTBOX_RENDER_SCALE;
         int scaledTextboxY = y * TEXTBOX_RENDER_SCALE;
-        for (int i = 0; i < TEXTBOX_RENDER_SCALE; i++) {
-            for (int j = 0; j < TEXTBOX_RENDER_SCALE; j++) {
-                drawingBuffers[TEXTBOX_BUFFER_ID][(scaledTextboxY + j) * textboxWidth + (scaledTextboxX + i)] = color;
-            }
-        }
+        blit_fill_rect(&drawingBuffers[TEXTBOX_BUFFER_ID][scaledTextboxY * textboxWidth + scaledTextboxX], textboxWidth, color, TEXTBOX_RENDER_SCALE, TEXTBOX_RENDER_SCALE);
+        present_textbox_changed();
     }
-    else if (curBufferId >= tileStartBufferId && curBufferId < nextBufferId && curGraphicsMode == 1) {
-        // Use scaled coordinates for tile buffer
-        for (int i = 0; i < RENDER_SCALE; i++) {
-            for (int j = 0; j < RENDER_SCALE; j++) {
-                drawingBuffers[curBufferId][(scaledY + j) * TILE_SIZE + (scaledX + i)] = color;
-            }
+    else if (tile_atlas_contains(curBufferId) && curGraphicsMode == 1) {
+        if (x >= TILE_SIZE / RENDER_SCALE || y >= TILE_SIZE / RENDER_SCALE) {
+            return;
         }
+
+        // Use scaled coordinates for tile buffer
+        bitsy_pixel_t *tile = tile_atlas_pixels(curBufferId);
+        blit_fill_rect(&tile[scaledY * TILE_SIZE + scaledX], TILE_SIZE, color, RENDER_SCALE, RENDER_SCALE);
     }
+}
 
+duk_ret_t bitsy_draw_pixel(duk_context *ctx)
+{
+    drawCallCount++;
+    draw_pixel(duk_get_int(ctx, 0), duk_get_int(ctx, 1), duk_get_int(ctx, 2));
     return 0;
 }
 
-duk_ret_t bitsy_draw_tile(duk_context *ctx)
+void draw_tile(int tileId, int x, int y)
 {
     // Can only draw tiles on the screen buffer in tile mode
     if (curBufferId != 0 || curGraphicsMode != 1) {
-        return 0;
+        return;
     }
 
-    int tileId = duk_get_int(ctx, 0);
-    int x = duk_get_int(ctx, 1);
-    int y = duk_get_int(ctx, 2);
-
     // Ensure the tileId is valid
-    if (tileId < tileStartBufferId || tileId >= nextBufferId) {
-        return 0;
+    if (!tile_atlas_contains(tileId)) {
+        return;
+    }
+
+    // Ensure the tile is on screen
+    if (x < 0 || x >= ROOM_SIZE || y < 0 || y >= ROOM_SIZE) {
+        return;
     }
 
-    // Calculate the tile position and size with render scale
+    // Calculate the tile position with render scale
     int scaledX = x * TILE_SIZE * RENDER_SCALE;
     int scaledY = y * TILE_SIZE * RENDER_SCALE;
-    //int scaledTileSize = TILE_SIZE * RENDER_SCALE;
-
-    // Iterate over each pixel of the tile and draw it to the screen buffer
-    for (int ty = 0; ty < TILE_SIZE; ty++) {
-        for (int tx = 0; tx < TILE_SIZE; tx++) {
-            lv_color_t color = drawingBuffers[tileId][ty * TILE_SIZE + tx]; // Get the pixel color from the tile buffer
-
-            // Scale the pixel drawing using RENDER_SCALE
-            for (int i = 0; i < RENDER_SCALE; i++) {
-                for (int j = 0; j < RENDER_SCALE; j++) {
-                    int bufferX = scaledX + (tx * RENDER_SCALE) + i;
-                    int bufferY = scaledY + (ty * RENDER_SCALE) + j;
-
-                    // Draw the scaled pixel on the screen buffer
-                    drawingBuffers[SCREEN_BUFFER_ID][bufferY * SCREEN_SIZE + bufferX] = color;
-                }
-            }
-        }
-    }
 
+    // Copy the tile to the screen buffer, scaled by RENDER_SCALE
+    blit_copy_rect(&drawingBuffers[SCREEN_BUFFER_ID][scaledY * SCREEN_SIZE + scaledX], SCREEN_SIZE,
+                   tile_atlas_pixels(tileId), TILE_SIZE, TILE_SIZE, TILE_SIZE, RENDER_SCALE);
+    present_mark_tile(x, y, TILE_SIGNATURE(tileId));
+}
+
+duk_ret_t bitsy_draw_tile(duk_context *ctx)
+{
+    drawCallCount++;
+    draw_tile(duk_get_int(ctx, 0), duk_get_int(ctx, 1), duk_get_int(ctx, 2));
     return 0;
 }
 
-duk_ret_t bitsy_draw_textbox(duk_context* ctx)
+// Like draw_tile, but pixels of the tile's clear color let what's already on screen show through,
+// so sprites and items go straight over the room background without redrawing the tile under them
+void draw_sprite(int tileId, int x, int y)
 {
-    // Can only draw the textbox on the screen buffer in tile mode
+    // Can only draw tiles on the screen buffer in tile mode
     if (curBufferId != 0 || curGraphicsMode != 1) {
-        return 0;
+        return;
     }
 
-    int x = duk_get_int(ctx, 0);
-    int y = duk_get_int(ctx, 1);
+    if (!tile_atlas_contains(tileId)) {
+        return;
+    }
 
-    // Calculate the scaled position of the textbox
-    int scaledX = x * TEXTBOX_RENDER_SCALE;
-    int scaledY = y * TEXTBOX_RENDER_SCALE;
+    if (x < 0 || x >= ROOM_SIZE || y < 0 || y >= ROOM_SIZE) {
+        return;
+    }
 
-    // Iterate over each pixel of the textbox buffer and scale it
-    for (int ty = 0; ty < textboxHeight; ty++) {
-        for (int tx = 0; tx < textboxWidth; tx++) {
-            lv_color_t color = drawingBuffers[TEXTBOX_BUFFER_ID][ty * textboxWidth + tx]; // Get the pixel color from the textbox buffer
+    int scaledX = x * TILE_SIZE * RENDER_SCALE;
+    int scaledY = y * TILE_SIZE * RENDER_SCALE;
 
-            // Scale the pixel drawing using TEXTBOX_RENDER_SCALE
-            for (int i = 0; i < TEXTBOX_RENDER_SCALE; i++) {
-                for (int j = 0; j < TEXTBOX_RENDER_SCALE; j++) {
-                    int bufferX = scaledX + (tx * TEXTBOX_RENDER_SCALE) + i;
-                    int bufferY = scaledY + (ty * TEXTBOX_RENDER_SCALE) + j;
+    blit_copy_rect_masked(&drawingBuffers[SCREEN_BUFFER_ID][scaledY * SCREEN_SIZE + scaledX], SCREEN_SIZE,
+                          tile_atlas_pixels(tileId), TILE_SIZE, TILE_MASK(tileId), TILE_SIZE, TILE_SIZE, RENDER_SCALE);
+    present_mark_tile(x, y, SPRITE_SIGNATURE(tileId));
+}
 
-                    // Draw the scaled pixel on the screen buffer
-                    drawingBuffers[SCREEN_BUFFER_ID][bufferY * SCREEN_SIZE + bufferX] = color;
-                }
-            }
-        }
+// bitsyDrawSprite(tileId, x, y): bitsyDrawTile with the tile's clear color transparent
+duk_ret_t bitsy_draw_sprite(duk_context *ctx)
+{
+    drawCallCount++;
+    draw_sprite(duk_get_int(ctx, 0), duk_get_int(ctx, 1), duk_get_int(ctx, 2));
+    return 0;
+}
+
+void draw_textbox(int x, int y)
+{
+    // Can only draw the textbox on the screen buffer in tile mode
+    if (curBufferId != 0 || curGraphicsMode != 1) {
+        return;
     }
 
+    // Composited over the screen at present time, so the screen under it isn't overwritten
+    // and nothing is copied while neither its content nor its position change
+    present_show_textbox(x, y);
+}
+
+duk_ret_t bitsy_draw_textbox(duk_context* ctx)
+{
+    drawCallCount++;
+    draw_textbox(duk_get_int(ctx, 0), duk_get_int(ctx, 1));
     return 0;
 }
 
-duk_ret_t bitsy_clear(duk_context* ctx)
+void draw_clear(int paletteIndex)
 {
-    int paletteIndex = duk_get_int(ctx, 0);
+    // Also stored as a tile's clear index, which build_tile_mask resolves later
+    if (paletteIndex < 0 || paletteIndex >= SYSTEM_PALETTE_MAX) {
+        return;
+    }
 
-    lv_color_t color = systemPalette[paletteIndex];
+    bitsy_pixel_t color = BITSY_PIXEL(paletteIndex);
 
     // Clear the screen buffer
     if (curBufferId == 0) {
-        for (int y = 0; y < SCREEN_SIZE * RENDER_SCALE; y++) {
-            for (int x = 0; x < SCREEN_SIZE * RENDER_SCALE; x++) {
-                drawingBuffers[SCREEN_BUFFER_ID][y * SCREEN_SIZE + x] = color;
-            }
-        }
+        blit_fill(drawingBuffers[SCREEN_BUFFER_ID], color, SCREEN_SIZE * SCREEN_SIZE);
+        present_mark_clear(CLEAR_SIGNATURE(paletteIndex));
     }
     // Clear the textbox buffer
     else if (curBufferId == 1) {
-        for (int y = 0; y < textboxHeight * TEXTBOX_RENDER_SCALE; y++) {
-            for (int x = 0; x < textboxWidth * TEXTBOX_RENDER_SCALE; x++) {
-                drawingBuffers[TEXTBOX_BUFFER_ID][y * textboxWidth + x] = color;
-            }
-        }
+        blit_fill(drawingBuffers[TEXTBOX_BUFFER_ID], color, textboxWidth * textboxHeight * TEXTBOX_RENDER_SCALE * TEXTBOX_RENDER_SCALE);
+        present_textbox_changed();
     }
-    // Clear the tile buffer
-    else if (curBufferId >= tileStartBufferId && curBufferId < nextBufferId) {
-        for (int y = 0; y < TILE_SIZE * RENDER_SCALE; y++) {
-            for (int x = 0; x < TILE_SIZE * RENDER_SCALE; x++) {
-                drawingBuffers[curBufferId][y * TILE_SIZE + x] = color;
-            }
-        }
+    // Clear the tile buffer, the clear color is what draw_sprite leaves out
+    else if (tile_atlas_contains(curBufferId)) {
+        blit_fill(tile_atlas_pixels(curBufferId), color, TILE_PIXEL_COUNT);
+        TILE_CLEAR_INDEX(curBufferId) = paletteIndex;
     }
+}
 
+duk_ret_t bitsy_clear(duk_context* ctx)
+{
+    drawCallCount++;
+    draw_clear(duk_get_int(ctx, 0));
     return 0;
 }
 
 duk_ret_t bitsy_add_tile(duk_context *ctx)
 {
-    if (nextBufferId >= SYSTEM_DRAWING_BUFFER_MAX)
+    // Slots come out of the preallocated atlas, nothing is allocated per tile
+    // A full atlas is already logged by tile_atlas_alloc. -1 is no tile: drawing into it or
+    // with it does nothing, so the game keeps running without the missing drawings.
+    int tileId = tile_atlas_alloc();
+    if (tileId < 0)
     {
-        // todo : error handling?
-        return 0;
+        duk_push_int(ctx, -1);
+        return 1;
     }
+    tileBuildCount++;
 
-    // free memory if it exists
-    if (drawingBuffers[nextBufferId] != NULL)
-    {
-        heap_caps_free(drawingBuffers[nextBufferId]);
+    // Opaque until the tile is cleared to a color and finished with bitsyDrawEnd
+    TILE_CLEAR_INDEX(tileId) = -1;
+    memset(TILE_MASK(tileId), 0xFF, TILE_SIZE);
+
+    duk_push_int(ctx, tileId);
+
+    return 1;
+}
+
+// Read one 0/1 value of a drawing bitmap, either a flat array or an array of rows
+static bool get_bitmap_bit(duk_context *ctx, duk_idx_t idx, int i, bool nested)
+{
+    bool bit;
+
+    if (nested) {
+        duk_get_prop_index(ctx, idx, i / TILE_SIZE);
+        duk_get_prop_index(ctx, -1, i % TILE_SIZE);
+        bit = duk_to_int(ctx, -1) != 0;
+        duk_pop_2(ctx);
+    }
+    else {
+        duk_get_prop_index(ctx, idx, i);
+        bit = duk_to_int(ctx, -1) != 0;
+        duk_pop(ctx);
     }
 
-    // allocate a new tile buffer
-    drawingBuffers[nextBufferId] = heap_caps_malloc(TILE_SIZE * TILE_SIZE * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);
-    if (!drawingBuffers[nextBufferId])
-    {
-        ESP_LOGE(TAG, "Failed to allocate memory for tile buffer");
+    return bit;
+}
+
+// bitsyAddTileFromBitmap(bitmap, fgIndex, bgIndex): builds a whole tile in one call instead of
+// bitsyAddTile, bitsyDrawBegin and 64 bitsyDrawPixel calls. bitmap is one frame of drawing data,
+// as a buffer of TILE_SIZE * TILE_SIZE bytes, a flat array, or an array of TILE_SIZE rows.
+duk_ret_t bitsy_add_tile_from_bitmap(duk_context *ctx)
+{
+    int fgIndex = duk_get_int(ctx, 1);
+    int bgIndex = duk_get_int(ctx, 2);
+
+    if (fgIndex < 0 || fgIndex >= SYSTEM_PALETTE_MAX || bgIndex < 0 || bgIndex >= SYSTEM_PALETTE_MAX) {
+        return DUK_RET_RANGE_ERROR;
     }
-    ESP_LOGI(TAG, "Allocated memory for tile buffer %d", nextBufferId);
 
-    duk_push_int(ctx, nextBufferId);
+    const uint8_t *bytes = NULL;
+    bool nested = false;
 
-    nextBufferId++;
+    if (duk_is_buffer_data(ctx, 0)) {
+        duk_size_t size = 0;
+        bytes = duk_get_buffer_data(ctx, 0, &size);
+        if (size < TILE_PIXEL_COUNT) {
+            return DUK_RET_RANGE_ERROR;
+        }
+    }
+    else if (duk_is_array(ctx, 0)) {
+        nested = duk_get_length(ctx, 0) == TILE_SIZE;
+        if (!nested && duk_get_length(ctx, 0) < TILE_PIXEL_COUNT) {
+            return DUK_RET_RANGE_ERROR;
+        }
+    }
+    else {
+        return DUK_RET_TYPE_ERROR;
+    }
+
+    int tileId = tile_atlas_alloc();
+    if (tileId < 0)
+    {
+        return 0;
+    }
+    tileBuildCount++;
+    bitmapTileBuildCount++;
+
+    bitsy_pixel_t fg = BITSY_PIXEL(fgIndex);
+    bitsy_pixel_t bg = BITSY_PIXEL(bgIndex);
+    bitsy_pixel_t *tile = tile_atlas_pixels(tileId);
+
+    // The mask comes straight from the bitmap: foreground pixels are opaque
+    uint8_t *mask = TILE_MASK(tileId);
+    memset(mask, 0, TILE_SIZE);
+    TILE_CLEAR_INDEX(tileId) = bgIndex;
+
+    for (int i = 0; i < TILE_PIXEL_COUNT; i++) {
+        bool bit = bytes != NULL ? bytes[i] != 0 : get_bitmap_bit(ctx, 0, i, nested);
+        tile[i] = bit ? fg : bg;
+        if (bit) {
+            mask[i / TILE_SIZE] |= 1u << (i % TILE_SIZE);
+        }
+    }
+    TILE_SIGNATURE(tileId) = present_new_signature();
+
+    duk_push_int(ctx, tileId);
 
     return 1;
 }
 
+void log_tile_builds(int64_t updateTime)
+{
+    // Only updates that built tiles, e.g. entering a room or changing palette
+    if (tileBuildCount > 0) {
+        ESP_LOGI(TAG, "Built %d tiles (%d from bitmaps) in an update of %" PRId64 " us",
+                 tileBuildCount, bitmapTileBuildCount, updateTime);
+    }
+
+    tileBuildCount = 0;
+    bitmapTileBuildCount = 0;
+}
+
 duk_ret_t bitsy_reset_tiles(duk_context *ctx)
 {
-    nextBufferId = tileStartBufferId;
+    // Report what the previous set of tiles used before releasing all of them at once
+    tile_atlas_log_usage();
+    tile_atlas_reset();
+
+    // The uploaded room refers to the released tile ids
+    room_reset();
     ESP_LOGI(TAG, "Reset tiles");
 
     return 0;
@@ -306,32 +510,54 @@ duk_ret_t bitsy_set_textbox_size(duk_context* ctx)
         return 0;
     }
 
-    // Free the old buffer if it exists to avoid memory leaks
-    if (drawingBuffers[TEXTBOX_BUFFER_ID] != NULL) {
-        heap_caps_free(drawingBuffers[TEXTBOX_BUFFER_ID]);
-    }
-
-    // Allocate new buffer based on the new textbox size and scale
-    int bufferSize = textboxWidth * TEXTBOX_RENDER_SCALE * textboxHeight * TEXTBOX_RENDER_SCALE * sizeof(lv_color_t);
-    drawingBuffers[TEXTBOX_BUFFER_ID] = (lv_color_t*) heap_caps_malloc(bufferSize, MALLOC_CAP_SPIRAM);
+    // Allocate new buffer based on the new textbox size and scale, the old one stays if this fails
+    int bufferSize = newTextboxWidth * TEXTBOX_RENDER_SCALE * newTextboxHeight * TEXTBOX_RENDER_SCALE * sizeof(bitsy_pixel_t);
+    bitsy_pixel_t *newBuffer = (bitsy_pixel_t*) heap_caps_malloc(bufferSize, MALLOC_CAP_SPIRAM);
 
-    if (drawingBuffers[TEXTBOX_BUFFER_ID] == NULL) {
+    if (newBuffer == NULL) {
         // Handle allocation failure
         return DUK_RET_ERROR;  // Return an error if memory allocation fails
     }
 
     // Clear the new buffer (initialize with some color, or leave as zero)
-    memset(drawingBuffers[TEXTBOX_BUFFER_ID], 0, bufferSize);
+    memset(newBuffer, 0, bufferSize);
+
+    // Free the old buffer if it exists to avoid memory leaks
+    if (drawingBuffers[TEXTBOX_BUFFER_ID] != NULL) {
+        heap_caps_free(drawingBuffers[TEXTBOX_BUFFER_ID]);
+    }
+
+    drawingBuffers[TEXTBOX_BUFFER_ID] = newBuffer;
+    textboxWidth = newTextboxWidth;
+    textboxHeight = newTextboxHeight;
+    present_textbox_changed();
 
     ESP_LOGI(TAG, "Set textbox size to %d x %d", textboxWidth, textboxHeight);
 
     return 0;  // Return success
 }
 
+// Engine callbacks live in the heap stash, out of reach of game scripts, and are called
+// with duk_pcall instead of compiling a call expression every frame
+static void stash_callback(duk_context *ctx, const char *key)
+{
+    duk_push_heap_stash(ctx);
+    duk_dup(ctx, 0);
+    duk_put_prop_string(ctx, -2, key);
+    duk_pop(ctx);
+}
+
+bool duk_push_bitsy_callback(duk_context *ctx, const char *key)
+{
+    duk_push_heap_stash(ctx);
+    duk_get_prop_string(ctx, -1, key);
+    duk_remove(ctx, -2);
+    return duk_is_function(ctx, -1);
+}
+
 duk_ret_t bitsy_on_load(duk_context *ctx)
 {
-    // hacky to just stick it in the global namespace??
-    duk_put_global_string(ctx, "__bitsybox_on_load__");
+    stash_callback(ctx, BITSY_CALLBACK_LOAD);
     ESP_LOGI(TAG, "LOADING");
 
     return 0;
@@ -339,18 +565,31 @@ duk_ret_t bitsy_on_load(duk_context *ctx)
 
 duk_ret_t bitsy_on_quit(duk_context *ctx)
 {
-    duk_put_global_string(ctx, "__bitsybox_on_quit__");
+    stash_callback(ctx, BITSY_CALLBACK_QUIT);
     ESP_LOGI(TAG, "QUITTING");
     return 0;
 }
 
 duk_ret_t bitsy_on_update(duk_context *ctx)
 {
-    duk_put_global_string(ctx, "__bitsybox_on_update__");
+    stash_callback(ctx, BITSY_CALLBACK_UPDATE);
+
+    return 0;
+}
 
+// bitsySetGameOver(isGameOver): ends the game loop after the current update
+duk_ret_t bitsy_set_game_over(duk_context *ctx)
+{
+    isGameOver = duk_to_boolean(ctx, 0);
     return 0;
 }
 
+duk_ret_t bitsy_get_game_over(duk_context *ctx)
+{
+    duk_push_boolean(ctx, isGameOver);
+    return 1;
+}
+
 void register_bitsy_api(duk_context *ctx)
 {
     duk_push_c_function(ctx, bitsy_log, 2);
@@ -359,6 +598,15 @@ void register_bitsy_api(duk_context *ctx)
     duk_push_c_function(ctx, bitsy_get_button, 1);
     duk_put_global_string(ctx, "bitsyGetButton");
 
+    duk_push_c_function(ctx, bitsy_get_time, 0);
+    duk_put_global_string(ctx, "bitsyGetTime");
+
+    // The engine times animations with Date.now, give it the game clock instead
+    duk_get_global_string(ctx, "Date");
+    duk_push_c_function(ctx, bitsy_get_time, 0);
+    duk_put_prop_string(ctx, -2, "now");
+    duk_pop(ctx);
+
     duk_push_c_function(ctx, bitsy_set_graphics_mode, 1);
     duk_put_global_string(ctx, "bitsySetGraphicsMode");
 
@@ -379,28 +627,77 @@ void register_bitsy_api(duk_context *ctx)
 
     duk_push_c_function(ctx, bitsy_draw_tile, 3);
     duk_put_global_string(ctx, "bitsyDrawTile");
+    duk_push_c_function(ctx, bitsy_draw_sprite, 3);
+    duk_put_global_string(ctx, "bitsyDrawSprite");
 
     duk_push_c_function(ctx, bitsy_draw_textbox, 2);
     duk_put_global_string(ctx, "bitsyDrawTextbox");
 
+    duk_push_c_function(ctx, bitsy_draw_char, 4);
+    duk_put_global_string(ctx, "bitsyDrawChar");
+    duk_push_c_function(ctx, bitsy_get_font_char, 1);
+    duk_put_global_string(ctx, "bitsyGetFontChar");
+
     duk_push_c_function(ctx, bitsy_clear, 1);
     duk_put_global_string(ctx, "bitsyClear");
 
     duk_push_c_function(ctx, bitsy_add_tile, 0);
     duk_put_global_string(ctx, "bitsyAddTile");
 
+    duk_push_c_function(ctx, bitsy_add_tile_from_bitmap, 3);
+    duk_put_global_string(ctx, "bitsyAddTileFromBitmap");
+
     duk_push_c_function(ctx, bitsy_reset_tiles, 0);
     duk_put_global_string(ctx, "bitsyResetTiles");
 
     duk_push_c_function(ctx, bitsy_set_textbox_size, 2);
     duk_put_global_string(ctx, "bitsySetTextboxSize");
 
+    duk_push_c_function(ctx, bitsy_set_room_tiles, 2);
+    duk_put_global_string(ctx, "bitsySetRoomTiles");
+
+    duk_push_c_function(ctx, bitsy_draw_room, 0);
+    duk_put_global_string(ctx, "bitsyDrawRoom");
+
+    duk_push_c_function(ctx, bitsy_get_room_cache_stats, 0);
+    duk_put_global_string(ctx, "bitsyGetRoomCacheStats");
+
+    duk_push_c_function(ctx, bitsy_draw_commands, 2);
+    duk_put_global_string(ctx, "bitsyDrawCommands");
+
+    duk_push_c_function(ctx, bitsy_begin_transition, 6);
+    duk_put_global_string(ctx, "bitsyBeginTransition");
+
+    duk_push_c_function(ctx, bitsy_is_transition_active, 0);
+    duk_put_global_string(ctx, "bitsyIsTransitionActive");
+
     duk_push_c_function(ctx, bitsy_on_load, 1);
     duk_put_global_string(ctx, "bitsyOnLoad");
 
     duk_push_c_function(ctx, bitsy_on_quit, 1);
     duk_put_global_string(ctx, "bitsyOnQuit");
 
+    duk_push_c_function(ctx, bitsy_set_game_over, 1);
+    duk_put_global_string(ctx, "bitsySetGameOver");
+
+    duk_push_c_function(ctx, bitsy_load_world_cache, 0);
+    duk_put_global_string(ctx, "bitsyLoadWorldCache");
+    duk_push_c_function(ctx, bitsy_save_world_cache, 1);
+    duk_put_global_string(ctx, "bitsySaveWorldCache");
+
+    duk_push_c_function(ctx, bitsy_get_game_sections, 1);
+    duk_put_global_string(ctx, "bitsyGetGameSections");
+    duk_push_c_function(ctx, bitsy_get_game_section, 2);
+    duk_put_global_string(ctx, "bitsyGetGameSection");
+
+    // Scripts that still assign __bitsybox_is_game_over__ go through the native flag
+    duk_push_global_object(ctx);
+    duk_push_string(ctx, "__bitsybox_is_game_over__");
+    duk_push_c_function(ctx, bitsy_get_game_over, 0);
+    duk_push_c_function(ctx, bitsy_set_game_over, 1);
+    duk_def_prop(ctx, -4, DUK_DEFPROP_HAVE_GETTER | DUK_DEFPROP_HAVE_SETTER | DUK_DEFPROP_SET_CONFIGURABLE);
+    duk_pop(ctx);
+
     duk_push_c_function(ctx, bitsy_on_update, 1);
     duk_put_global_string(ctx, "bitsyOnUpdate");
 }
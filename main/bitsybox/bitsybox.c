@@ -2,15 +2,26 @@
 #include "esp_system.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "display.h"
+#include "assets.h"
 
 static const char *TAG = "BitsyBox";
 
-lv_color_t systemPalette[SYSTEM_PALETTE_MAX];
-lv_color_t *drawingBuffers[SYSTEM_DRAWING_BUFFER_MAX];
+bitsy_color_t systemPalette[SYSTEM_PALETTE_MAX];
+bitsy_pixel_t *drawingBuffers[SYSTEM_DRAWING_BUFFER_MAX];
 
-lv_obj_t *canvas;
-lv_color_t *canvas_buffer;
+int64_t gameClock = 0;
+
+// Longest the game loop runs without blocking when it can't keep up
+#define IDLE_YIELD_INTERVAL 1000000
+
+// A tick this close to due runs now, the task wakes on OS tick boundaries a little off the
+// esp_timer time it was aiming for
+#define TICK_WAKE_SLACK 1000
+
+// When run_bitsy_game started, for the time to first frame
+static int64_t launchTime = 0;
 
 static void log_mem()
 {
@@ -38,76 +49,113 @@ static void duk_fatal_error(void *udata, const char *msg)
     ESP_LOGE(TAG, "Fatal error: %s", msg);
 }
 
-bool duk_load_precompiled_script(duk_context *ctx, const char *filepath) {
-    FILE *f = fopen(filepath, "rb");
-    if (!f) {
-        ESP_LOGE(TAG, "Failed to open bytecode file: %s", filepath);
+// Decompressed assets are produced this many bytes at a time
+#define ASSET_READ_CHUNK_SIZE 4096
+
+static size_t psram_in_use(void)
+{
+    return heap_caps_get_total_size(MALLOC_CAP_SPIRAM) - heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+}
+
+// Decompress an asset chunk by chunk straight into a Duktape buffer of its final size, without
+// a second buffer for the compressed data
+static bool duk_push_asset_buffer(duk_context *ctx, vgc_asset_reader_t *reader)
+{
+    uint8_t *buf = duk_push_fixed_buffer(ctx, reader->rawSize);
+
+    size_t pos = 0;
+    int count;
+    while ((count = vgc_assets_read(reader, buf + pos, ASSET_READ_CHUNK_SIZE)) > 0) {
+        pos += count;
+    }
+
+    if (count < 0 || pos != reader->rawSize) {
+        duk_pop(ctx);
         return false;
     }
 
-    fseek(f, 0, SEEK_END);
-    long length = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    return true;
+}
+
+bool duk_load_precompiled_script(duk_context *ctx, const char *filepath) {
+    int64_t startTime = esp_timer_get_time();
+    size_t heapBefore = psram_in_use();
 
-    // Allocate memory for the bytecode
-    char *bytecode = heap_caps_malloc(length, MALLOC_CAP_SPIRAM);
-    if (bytecode) {
-        fread(bytecode, 1, length, f);
-        fclose(f);
+    vgc_asset_reader_t reader;
+    if (!vgc_assets_open(filepath, &reader)) {
+        ESP_LOGE(TAG, "Failed to open bytecode file: %s", filepath);
+        return false;
+    }
 
-        // Push bytecode as a buffer, not as a string
-        void *buf = duk_push_fixed_buffer(ctx, length);
-        memcpy(buf, bytecode, length);
+    if (reader.decoder == NULL) {
+        // Point Duktape straight at the bytecode in mapped flash, nothing is copied before loading.
+        // Duktape never writes to a buffer it loads a function from.
+        duk_push_external_buffer(ctx);
+        duk_config_buffer(ctx, -1, (void *)reader.data, reader.size);
+    }
+    else if (!duk_push_asset_buffer(ctx, &reader)) {
+        ESP_LOGE(TAG, "Failed to decompress bytecode file: %s", filepath);
+        vgc_assets_close(&reader);
+        return false;
+    }
+    vgc_assets_close(&reader);
 
-        // Load the precompiled function from the bytecode buffer
-        duk_load_function(ctx);
+    int64_t readTime = esp_timer_get_time() - startTime;
 
-        // Execute the loaded function (e.g., global scope)
-        if (duk_pcall(ctx, 0) != 0) {
-            ESP_LOGE(TAG, "Bytecode execution error: %s\n", duk_safe_to_string(ctx, -1));
-            heap_caps_free(bytecode);
-            return false;
-        }
+    // Load the precompiled function from the bytecode buffer
+    duk_load_function(ctx);
+    size_t heapPeak = psram_in_use();
 
-        // Free the bytecode buffer
-        heap_caps_free(bytecode);
-    } else {
-        ESP_LOGE(TAG, "Failed to allocate memory for bytecode.");
-        fclose(f);
+    // Execute the loaded function (e.g., global scope)
+    if (duk_pcall(ctx, 0) != 0) {
+        ESP_LOGE(TAG, "Bytecode execution error: %s\n", duk_safe_to_string(ctx, -1));
+        duk_pop(ctx);
         return false;
     }
+    duk_pop(ctx);
+
+    size_t heapAfter = psram_in_use();
+    if (heapAfter > heapPeak) {
+        heapPeak = heapAfter;
+    }
+
+    ESP_LOGI(TAG, "Loaded %s: %d bytes (%d in flash) in %" PRId64 " us (%" PRId64 " us reading), heap peak +%d KB, retained +%d KB",
+             filepath, (int)reader.rawSize, (int)reader.size, esp_timer_get_time() - startTime, readTime,
+             ((int)heapPeak - (int)heapBefore) / 1024, ((int)heapAfter - (int)heapBefore) / 1024);
 
     return true;
 }
 
 bool duk_load_file(duk_context *ctx, const char *filepath, const char *globalName)
 {
-    FILE *f = fopen(filepath, "rb");
-    if (!f) {
-        ESP_LOGE(TAG, "Failed to open font file: %s", filepath);
+    int64_t startTime = esp_timer_get_time();
+
+    vgc_asset_reader_t reader;
+    if (!vgc_assets_open(filepath, &reader)) {
+        ESP_LOGE(TAG, "Failed to open file: %s", filepath);
         return false;
     }
 
-    fseek(f, 0, SEEK_END);
-    long length = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
-    char *fontData = heap_caps_malloc(length, MALLOC_CAP_SPIRAM);
-    if (fontData) {
-        fread(fontData, 1, length, f);
-        fclose(f);
-
-        // Load the font data onto the Duktape stack
-        duk_push_lstring(ctx, fontData, length);
-        duk_put_global_string(ctx, globalName);
-
-        // Free font data buffer after loading
-        heap_caps_free(fontData);
-    } else {
-        ESP_LOGE(TAG, "Failed to allocate memory for font data.");
-        fclose(f);
+    if (reader.decoder == NULL) {
+        // Strings live in the Duktape heap, so this is the only copy
+        duk_push_lstring(ctx, (const char *)reader.data, reader.size);
+    }
+    else if (duk_push_asset_buffer(ctx, &reader)) {
+        // Duktape copies the buffer into a new string, so the heap briefly holds the text twice
+        // until the buffer it replaces on the stack is freed
+        duk_buffer_to_string(ctx, -1);
+    }
+    else {
+        ESP_LOGE(TAG, "Failed to decompress file: %s", filepath);
+        vgc_assets_close(&reader);
         return false;
     }
+    vgc_assets_close(&reader);
+
+    duk_put_global_string(ctx, globalName);
+
+    ESP_LOGI(TAG, "Loaded %s: %d bytes (%d in flash) in %" PRId64 " us",
+             filepath, (int)reader.rawSize, (int)reader.size, esp_timer_get_time() - startTime);
 
     return true;
 }
@@ -118,12 +166,12 @@ bool duk_load_bitsy_engine(duk_context *ctx)
 
     // load engine scripts
     const char *scripts[] = {
-        "/spiflash/bitsy/engine/script.bin",
-        "/spiflash/bitsy/engine/font.bin",
-        "/spiflash/bitsy/engine/transition.bin",
-        "/spiflash/bitsy/engine/dialog.bin",
-        "/spiflash/bitsy/engine/renderer.bin",
-        "/spiflash/bitsy/engine/bitsy.bin"};
+        "engine/script.bin",
+        "engine/font.bin",
+        "engine/transition.bin",
+        "engine/dialog.bin",
+        "engine/renderer.bin",
+        "engine/bitsy.bin"};
 
     for (int i = 0; i < sizeof(scripts) / sizeof(scripts[0]); i++)
     {
@@ -134,122 +182,305 @@ bool duk_load_bitsy_engine(duk_context *ctx)
         }
     }
 
-    // load font
-    const char *font_path = "/spiflash/bitsy/font/ascii_small.bitsyfont";
-    if (!duk_load_file(ctx, font_path, "__bitsybox_default_font__"))
+    // Cached worlds are only good for the engine that parsed them
+    world_cache_set_engine(scripts, sizeof(scripts) / sizeof(scripts[0]));
+
+    // load the native font, glyphs are drawn from it by bitsyDrawChar
+    const char *font_path = "font/ascii_small.bfnt";
+    if (!init_font(font_path))
     {
         ESP_LOGE(TAG, "Failed to load font: %s", font_path);
         success = false;
     }
+
+#if JS_FONT_DATA
+    const char *font_text_path = "font/ascii_small.bitsyfont";
+    if (!duk_load_file(ctx, font_text_path, "__bitsybox_default_font__"))
+    {
+        ESP_LOGE(TAG, "Failed to load font: %s", font_text_path);
+        success = false;
+    }
+#else
+    // The engine only needs the font name and size, glyphs come from the native font
+    if (!font_push_header(ctx))
+    {
+        duk_push_string(ctx, "");
+    }
+    duk_put_global_string(ctx, "__bitsybox_default_font__");
+#endif
     return success;
 }
 
+#if BENCHMARK_CALLBACK_DISPATCH
+// Per frame cost of calling the engine through source strings (compile, global lookup, call, and
+// the same again for the game over flag) against a cached function and the native flag.
+// Both call an empty function, so only the dispatch overhead is left.
+static void benchmark_callback_dispatch(duk_context *ctx)
+{
+    const int iterations = 100;
+
+    duk_peval_string(ctx, "var __bitsybox_benchmark_noop__ = function () {}; var __bitsybox_benchmark_flag__ = false;");
+    duk_pop(ctx);
+
+    int64_t startTime = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++)
+    {
+        duk_peval_string(ctx, "__bitsybox_benchmark_noop__();");
+        duk_pop(ctx);
+        duk_peval_string(ctx, "__bitsybox_benchmark_flag__");
+        duk_get_boolean(ctx, -1);
+        duk_pop(ctx);
+    }
+    int64_t evalTime = esp_timer_get_time() - startTime;
+
+    duk_push_heap_stash(ctx);
+    duk_get_global_string(ctx, "__bitsybox_benchmark_noop__");
+    duk_put_prop_string(ctx, -2, "benchmarkNoop");
+    duk_pop(ctx);
+
+    startTime = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++)
+    {
+        duk_push_bitsy_callback(ctx, "benchmarkNoop");
+        duk_pcall(ctx, 0);
+        duk_pop(ctx);
+    }
+    int64_t callTime = esp_timer_get_time() - startTime;
+
+    ESP_LOGI(TAG, "Callback dispatch: %" PRId64 " us/frame with peval, %" PRId64 " us/frame cached, %" PRId64 " us/frame saved",
+             evalTime / iterations, callTime / iterations, (evalTime - callTime) / iterations);
+
+    duk_push_heap_stash(ctx);
+    duk_del_prop_string(ctx, -1, "benchmarkNoop");
+    duk_pop(ctx);
+}
+#endif
+
 void duk_run_bitsy_game_loop(duk_context *ctx)
 {
     // set game over flag
-    int isGameOver = 0;
-    duk_peval_string(ctx, "var __bitsybox_is_game_over__ = false;");
-    duk_pop(ctx);
+    isGameOver = false;
 
     // Load game
-    if (duk_peval_string(ctx, "__bitsybox_on_load__(__bitsybox_game_data__, __bitsybox_default_font__);") != 0)
+    gameClock = esp_timer_get_time();
+    duk_push_bitsy_callback(ctx, BITSY_CALLBACK_LOAD);
+    duk_get_global_string(ctx, "__bitsybox_game_data__");
+    duk_get_global_string(ctx, "__bitsybox_default_font__");
+    if (duk_pcall(ctx, 2) != 0)
     {
         printf("Load Bitsy Error: %s\n", duk_safe_to_string(ctx, -1));
     }
     duk_pop(ctx);
+    ESP_LOGI(TAG, "Game loaded in %" PRId64 " us", esp_timer_get_time() - gameClock);
+    bool firstFrame = true;
+
+#if BENCHMARK_CALLBACK_DISPATCH
+    benchmark_callback_dispatch(ctx);
+#endif
+
+    // Main game loop: logic ticks run on a fixed timestep, the screen is presented once per
+    // loop so ticks that fall behind are caught up without rendering the frames in between
+    const int64_t tickPeriod = 1000000 / TARGET_FRAME_RATE;
+    const int64_t osTickPeriod = portTICK_PERIOD_MS * 1000;
+    int64_t nextTickTime = esp_timer_get_time();
+    int64_t statsStartTime = nextTickTime;
+    int tickCount = 0;
+    int frameCount = 0;
+    int droppedTickCount = 0;
+    int64_t sleepTimeTotal = 0;
+    int64_t updateTimeTotal = 0;
+    int64_t presentTimeTotal = 0;
+
+    // OS tick count at a known esp_timer time, to turn nextTickTime into a wake tick. Taken again
+    // right after every wake, when the two clocks line up with a tick boundary.
+    TickType_t anchorTick = xTaskGetTickCount();
+    int64_t anchorTime = esp_timer_get_time();
+    int64_t lastBlockTime = anchorTime;
 
-    // Main game loop
     while (!isGameOver)
     {
-        // Get input
-        get_input();
+        int64_t now = esp_timer_get_time();
 
-        // Update game state
-        if (duk_peval_string(ctx, "__bitsybox_on_update__();") != 0)
+        int ticks = 0;
+        while (now + TICK_WAKE_SLACK >= nextTickTime && ticks < MAX_UPDATES_PER_FRAME && !isGameOver)
         {
-            printf("Update Bitsy Error: %s\n", duk_safe_to_string(ctx, -1));
+            // JS sees the scheduled time of this tick, so deltaTime stays exact while catching up
+            gameClock = nextTickTime;
+
+            int64_t updateStartTime = now;
+
+            // Get input
+            get_input();
+
+            // The textbox only stays up if this update draws it again
+            present_hide_textbox();
+
+            // Update game state
+            duk_push_bitsy_callback(ctx, BITSY_CALLBACK_UPDATE);
+            if (duk_pcall(ctx, 0) != 0)
+            {
+                printf("Update Bitsy Error: %s\n", duk_safe_to_string(ctx, -1));
+            }
+            duk_pop(ctx);
+
+            // Advance a native transition started during the update
+            update_transition(ctx);
+
+            // Exit game if all buttons are pressed
+            if (isButtonUp && isButtonDown && isButtonLeft && isButtonRight)
+            {
+                // set game over flag
+                isGameOver = true;
+            }
+
+            nextTickTime += tickPeriod;
+            ticks++;
+            now = esp_timer_get_time();
+            updateTimeTotal += now - updateStartTime;
+            log_tile_builds(now - updateStartTime);
         }
-        duk_pop(ctx);
 
-        // Draw screen buffer to LCD
-        lvgl_port_lock(0);
-        lv_layer_t layer;
-        lv_canvas_init_layer(canvas, &layer);
-        // copy screen buffer to canvas buffer
-        for (int i = 0; i < SCREEN_SIZE * SCREEN_SIZE; i++)
+        // Too far behind to catch up, drop the backlog instead of spiralling
+        if (now - nextTickTime >= tickPeriod)
         {
-            lv_canvas_set_px(canvas, i % SCREEN_SIZE, i / SCREEN_SIZE, drawingBuffers[SCREEN_BUFFER_ID][i], LV_OPA_COVER);
+            droppedTickCount += (now - nextTickTime) / tickPeriod;
+            nextTickTime = now;
         }
-        lv_canvas_finish_layer(canvas, &layer);
-        lvgl_port_unlock();
 
-        // Exit game if all buttons are pressed
-        if (isButtonUp && isButtonDown && isButtonLeft && isButtonRight)
+        if (ticks > 0)
         {
-            // set game over flag
-            duk_peval_string(ctx, "__bitsybox_is_game_over__ = true;");
-            duk_pop(ctx);
+            // Hand the screen buffer to the compositor on the other core
+            int64_t presentStartTime = esp_timer_get_time();
+            present_frame();
+            presentTimeTotal += esp_timer_get_time() - presentStartTime;
+
+            if (firstFrame)
+            {
+                // Warm boots restore the parsed world instead of running parseWorld
+                ESP_LOGI(TAG, "Time to first frame: %" PRId64 " us (%s)", esp_timer_get_time() - launchTime,
+                         world_cache_was_hit() ? "warm, world from cache" : "cold, world parsed");
+                firstFrame = false;
+            }
+            tickCount += ticks;
+            frameCount++;
         }
 
-        // Check if game over
-        if (duk_peval_string(ctx, "__bitsybox_is_game_over__") != 0)
+        // Sleep until the OS tick at or after the next logic tick, giving LVGL and the idle task
+        // the CPU. Behind schedule there's no sleep, the next ticks are due already.
+        int64_t sleepStartTime = esp_timer_get_time();
+        if (nextTickTime > sleepStartTime + TICK_WAKE_SLACK)
         {
-            printf("Test Game Over Error: %s\n", duk_safe_to_string(ctx, -1));
+            TickType_t previousWakeTick = anchorTick;
+            TickType_t wakeTicks = (nextTickTime - anchorTime + osTickPeriod - 1) / osTickPeriod;
+            if (xTaskDelayUntil(&previousWakeTick, wakeTicks) == pdTRUE)
+            {
+                anchorTick = xTaskGetTickCount();
+                anchorTime = esp_timer_get_time();
+                lastBlockTime = anchorTime;
+            }
+            sleepTimeTotal += esp_timer_get_time() - sleepStartTime;
+        }
+        else if (sleepStartTime - lastBlockTime >= IDLE_YIELD_INTERVAL)
+        {
+            // Behind for that long, let IDLE on this core run once so the task watchdog stays fed
+            vTaskDelay(1);
+            anchorTick = xTaskGetTickCount();
+            anchorTime = esp_timer_get_time();
+            lastBlockTime = anchorTime;
+            sleepTimeTotal += anchorTime - sleepStartTime;
+        }
+
+        if (now - statsStartTime >= 5000000)
+        {
+            int64_t elapsed = now - statsStartTime;
+            ESP_LOGI(TAG, "Scheduler (core %d): %d ticks/s, %d frames/s, %d ticks dropped, %" PRId64 "%% asleep",
+                     xPortGetCoreID(), (int)(tickCount * 1000000LL / elapsed), (int)(frameCount * 1000000LL / elapsed),
+                     droppedTickCount, sleepTimeTotal * 100 / elapsed);
+            ESP_LOGI(TAG, "Stages: update %" PRId64 " us/tick, present %" PRId64 " us/frame",
+                     tickCount ? updateTimeTotal / tickCount : 0, frameCount ? presentTimeTotal / frameCount : 0);
+            log_draw_stats(tickCount); // the engine draws once per update
+            log_room_stats();
+            statsStartTime = now;
+            tickCount = 0;
+            frameCount = 0;
+            droppedTickCount = 0;
+            sleepTimeTotal = 0;
+            updateTimeTotal = 0;
+            presentTimeTotal = 0;
         }
-        isGameOver = duk_get_boolean(ctx, -1);
-        duk_pop(ctx);
     }
 
     // Quit game
-    if (duk_peval_string(ctx, "__bitsybox_on_quit__();") != 0)
+    duk_push_bitsy_callback(ctx, BITSY_CALLBACK_QUIT);
+    if (duk_pcall(ctx, 0) != 0)
     {
         printf("Quit Bitsy Error: %s\n", duk_safe_to_string(ctx, -1));
     }
     duk_pop(ctx);
 }
 
-void app_duktape_bitsy()
+static void run_bitsy_game()
 {
-    // Initialize system palette
-    systemPalette[0] = lv_color_make(255, 0, 0); // red
-    systemPalette[1] = lv_color_make(0, 255, 0); // green
-    systemPalette[2] = lv_color_make(0, 0, 255); // blue
-
-    canvas_buffer = heap_caps_malloc(128 * 128 * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);
+    launchTime = esp_timer_get_time();
 
-    lvgl_port_lock(0);
-    canvas = lv_canvas_create(lv_scr_act());
-    lv_canvas_set_buffer(canvas, canvas_buffer, 128, 128, LV_COLOR_FORMAT_RGB565);
-    lv_obj_center(canvas);
-    lv_canvas_fill_bg(canvas, lv_color_make(0, 0, 255), LV_OPA_COVER);
-    lvgl_port_unlock();
+    // Initialize system palette
+    systemPalette[0] = bitsy_color_make(255, 0, 0); // red
+    systemPalette[1] = bitsy_color_make(0, 255, 0); // green
+    systemPalette[2] = bitsy_color_make(0, 0, 255); // blue
 
     // Initialize drawing buffers
-    drawingBuffers[0] = heap_caps_malloc(SCREEN_SIZE * SCREEN_SIZE * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);  // screen buffer
+    drawingBuffers[0] = heap_caps_malloc(SCREEN_SIZE * SCREEN_SIZE * sizeof(bitsy_pixel_t), MALLOC_CAP_SPIRAM);  // screen buffer
     if (drawingBuffers[0] == NULL) {
         ESP_LOGE(TAG, "Failed to allocate memory for screen buffer");
         return;
     }
 
+    memset(drawingBuffers[0], 0, SCREEN_SIZE * SCREEN_SIZE * sizeof(bitsy_pixel_t));
+
     log_mem();
 
-    drawingBuffers[1] = heap_caps_malloc(104 * 38 * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);  // textbox buffer
+    drawingBuffers[1] = heap_caps_malloc(104 * 38 * sizeof(bitsy_pixel_t), MALLOC_CAP_SPIRAM);  // textbox buffer
     if (drawingBuffers[1] == NULL) {
         ESP_LOGE(TAG, "Failed to allocate memory for textbox buffer");
         heap_caps_free(drawingBuffers[0]);
         return;
     }
 
+    // Initialize the tile atlas
+    if (!init_tile_atlas()) {
+        heap_caps_free(drawingBuffers[0]);
+        heap_caps_free(drawingBuffers[1]);
+        return;
+    }
+
+    // Initialize the room background cache
+    if (!init_room()) {
+        deinit_tile_atlas();
+        heap_caps_free(drawingBuffers[0]);
+        heap_caps_free(drawingBuffers[1]);
+        return;
+    }
+
+    // Initialize the present path to the LCD
+    if (!init_present()) {
+        deinit_room();
+        deinit_tile_atlas();
+        heap_caps_free(drawingBuffers[0]);
+        heap_caps_free(drawingBuffers[1]);
+        return;
+    }
+
     log_mem();
 
-    // Create Duktape heap
+    // Create Duktape heap. From here on every failure goes through cleanup, the compositor
+    // task holds the LVGL lock until deinit_present stops it.
     duk_context *ctx = NULL;
     ctx = duk_create_heap(duk_psram_alloc, duk_psram_realloc, duk_psram_free, NULL, duk_fatal_error);
 
     if (!ctx)
     {
         ESP_LOGE(TAG, "Failed to create Duktape heap");
-        return;
+        goto cleanup;
     }
 
     ESP_LOGI(TAG, "Duktape heap created successfully!");
@@ -265,18 +496,39 @@ void app_duktape_bitsy()
     if (!engine_loaded)
     {
         ESP_LOGE(TAG, "Failed to load Bitsy engine scripts");
-        return;
+        goto cleanup;
     }
     ESP_LOGI(TAG, "Bitsy engine loaded");
 
     // Load game data
-    const char *gameFilePath = "/spiflash/bitsy/games/mossland.bitsy";
+    const char *gameFilePath = "games/mossland.bitsy";
+#if STREAM_GAME_DATA
+    // Only the header goes into the Duktape heap, sections are fetched from the index on demand
+    size_t heapBefore = psram_in_use();
+    if (!init_game_data(gameFilePath) || !game_data_push_header(ctx))
+    {
+        ESP_LOGE(TAG, "Failed to load game data: %s", gameFilePath);
+        goto cleanup;
+    }
+    duk_put_global_string(ctx, "__bitsybox_game_data__");
+    duk_push_true(ctx);
+    duk_put_global_string(ctx, "__bitsybox_game_streamed__");
+    ESP_LOGI(TAG, "Game index and header use %d KB of PSRAM", (int)((psram_in_use() - heapBefore) / 1024));
+#else
     if (!duk_load_file(ctx, gameFilePath, "__bitsybox_game_data__"))
     {
         ESP_LOGE(TAG, "Failed to load game data: %s", gameFilePath);
-        return;
+        goto cleanup;
     }
 
+    // The parsed world cache is keyed by the game text
+    duk_size_t gameDataLength = 0;
+    duk_get_global_string(ctx, "__bitsybox_game_data__");
+    const char *gameData = duk_get_lstring(ctx, -1, &gameDataLength);
+    world_cache_set_game(gameFilePath, gameData, gameDataLength);
+    duk_pop(ctx);
+#endif
+
     log_mem();
 
     // initialize input
@@ -287,18 +539,53 @@ void app_duktape_bitsy()
 
     log_mem();
 
-    // Free buffers
-    heap_caps_free(canvas_buffer);
+cleanup:
+    // Tear down in the reverse order of initialization
+    deinit_transition();
+    deinit_game_data();
+    deinit_font();
+    if (ctx)
+    {
+        duk_destroy_heap(ctx);
+        ESP_LOGI(TAG, "Duktape heap destroyed");
+    }
+    deinit_present();
+    deinit_room();
+    tile_atlas_log_usage();
+    deinit_tile_atlas();
     for (int i = 0; i < SYSTEM_DRAWING_BUFFER_MAX; i++)
     {
         if (drawingBuffers[i])
         {
             heap_caps_free(drawingBuffers[i]);
+            drawingBuffers[i] = NULL;
         }
     }
 
-    // Clean up and destroy the Duktape heap
-    duk_destroy_heap(ctx);
+    ESP_LOGI(TAG, "Program completed.");
+}
+
+static void bitsy_game_task(void *arg)
+{
+    TaskHandle_t caller = arg;
+
+    run_bitsy_game();
+
+    // Let app_duktape_bitsy return
+    xTaskNotifyGive(caller);
+    vTaskDelete(NULL);
+}
+
+void app_duktape_bitsy()
+{
+    // Pin the game loop so it never competes with the compositor on the other core
+    TaskHandle_t caller = xTaskGetCurrentTaskHandle();
+    if (xTaskCreatePinnedToCore(bitsy_game_task, "bitsybox", GAME_TASK_STACK_SIZE, caller, GAME_TASK_PRIORITY, NULL, GAME_TASK_CORE) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create game task");
+        return;
+    }
 
-    ESP_LOGI(TAG, "Duktape heap destroyed and program completed.");
+    // Wait for the game to end
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 }
\ No newline at end of file
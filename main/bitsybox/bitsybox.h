@@ -12,7 +12,7 @@
 #include <duktape.h>
 
 #define SYSTEM_PALETTE_MAX 256
-#define SYSTEM_DRAWING_BUFFER_MAX 1024
+#define SYSTEM_DRAWING_BUFFER_MAX 2 /* Screen and textbox, tiles live in the tile atlas */
 
 #define SCREEN_SIZE 128
 #define TILE_SIZE 8
@@ -20,11 +20,66 @@
 #define RENDER_SCALE 1
 #define TEXTBOX_RENDER_SCALE 1
 
+/* Store palette indices in the drawing buffers and resolve them only when presenting.
+   Overridable so the host tests can check both pixel formats. */
+#ifndef INDEXED_FRAMEBUFFER
+#define INDEXED_FRAMEBUFFER 1
+#endif
+
+/* Also hand the .bitsyfont text to the engine. Without it the engine only gets the font header
+   and must draw with bitsyDrawChar and measure with bitsyGetFontChar from the binary font */
+#define JS_FONT_DATA 1
+
+/* Keep only an index of the .bitsy sections and hand the engine the header as game data. The engine
+   must then fetch rooms, drawings and dialogs with bitsyGetGameSection when it first needs them */
+#define STREAM_GAME_DATA 0
+
+/* Time peval'd callback dispatch against the cached callbacks once after loading */
+#define BENCHMARK_CALLBACK_DISPATCH 0
+
+#define TARGET_FRAME_RATE 30
+#define MAX_UPDATES_PER_FRAME 4
+
+/* Game logic and Duktape run on one core, composition and panel flush on the other */
+#define GAME_TASK_CORE 0
+#define GAME_TASK_STACK_SIZE (32 * 1024)
+#define GAME_TASK_PRIORITY 2
+#define PRESENT_TASK_CORE 1
+
 #define SCREEN_BUFFER_ID 0
 #define TEXTBOX_BUFFER_ID 1
 
-extern lv_color_t systemPalette[SYSTEM_PALETTE_MAX];
-extern lv_color_t *drawingBuffers[SYSTEM_DRAWING_BUFFER_MAX];
+/* Tile ids continue after the drawing buffer ids */
+#define TILE_PIXEL_COUNT (TILE_SIZE * TILE_SIZE)
+#define TILE_ATLAS_FIRST_ID SYSTEM_DRAWING_BUFFER_MAX
+#define TILE_ATLAS_CAPACITY 1022
+
+/* Panel native color: RGB565 with the bytes already swapped for the SPI transfer */
+typedef uint16_t bitsy_color_t;
+
+static inline bitsy_color_t bitsy_color_make(uint8_t r, uint8_t g, uint8_t b)
+{
+    uint16_t color = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+    return (color >> 8) | (color << 8);
+}
+
+/* Pixel as stored in the drawing buffers */
+#if INDEXED_FRAMEBUFFER
+typedef uint8_t bitsy_pixel_t;
+#define BITSY_PIXEL(paletteIndex) ((bitsy_pixel_t)(paletteIndex))
+#define BITSY_PIXEL_COLOR(pixel) (systemPalette[(pixel)])
+#else
+typedef bitsy_color_t bitsy_pixel_t;
+#define BITSY_PIXEL(paletteIndex) (systemPalette[(paletteIndex)])
+#define BITSY_PIXEL_COLOR(pixel) (pixel)
+#endif
+
+extern bitsy_color_t systemPalette[SYSTEM_PALETTE_MAX];
+extern bitsy_pixel_t *drawingBuffers[SYSTEM_DRAWING_BUFFER_MAX];
+extern bitsy_pixel_t *tileAtlas;
+
+/* Time of the current logic tick in microseconds */
+extern int64_t gameClock;
 
 /* INPUT */
 extern bool isButtonUp;
@@ -57,8 +112,16 @@ void init_input(void);
 void get_input(void);
 
 /* API */
+#define BITSY_CALLBACK_LOAD "onLoad"
+#define BITSY_CALLBACK_UPDATE "onUpdate"
+#define BITSY_CALLBACK_QUIT "onQuit"
+#define BITSY_CALLBACK_TRANSITION_DONE "onTransitionDone"
+
+extern bool isGameOver;
+
 duk_ret_t bitsy_log(duk_context *ctx);
 duk_ret_t bitsy_get_button(duk_context *ctx);
+duk_ret_t bitsy_get_time(duk_context *ctx);
 duk_ret_t bitsy_set_graphics_mode(duk_context *ctx);
 duk_ret_t bitsy_set_color(duk_context *ctx);
 duk_ret_t bitsy_reset_colors(duk_context *ctx);
@@ -66,16 +129,147 @@ duk_ret_t bitsy_draw_begin(duk_context *ctx);
 duk_ret_t bitsy_draw_end(duk_context *ctx);
 duk_ret_t bitsy_draw_pixel(duk_context *ctx);
 duk_ret_t bitsy_draw_tile(duk_context *ctx);
+duk_ret_t bitsy_draw_sprite(duk_context *ctx);
 duk_ret_t bitsy_draw_textbox(duk_context *ctx);
 duk_ret_t bitsy_clear(duk_context *ctx);
 duk_ret_t bitsy_add_tile(duk_context *ctx);
+duk_ret_t bitsy_add_tile_from_bitmap(duk_context *ctx);
 duk_ret_t bitsy_reset_tiles(duk_context *ctx);
+void log_tile_builds(int64_t updateTime);
 duk_ret_t bitsy_set_textbox_size(duk_context *ctx);
 duk_ret_t bitsy_on_load(duk_context *ctx);
 duk_ret_t bitsy_on_quit(duk_context *ctx);
 duk_ret_t bitsy_on_update(duk_context *ctx);
+duk_ret_t bitsy_set_game_over(duk_context *ctx);
+duk_ret_t bitsy_get_game_over(duk_context *ctx);
+bool duk_push_bitsy_callback(duk_context *ctx, const char *key);
 void register_bitsy_api(duk_context *ctx);
 
+/* DRAW */
+extern int curGraphicsMode;
+extern int curBufferId;
+extern int drawCallCount;
+extern int textboxWidth;
+extern int textboxHeight;
+void draw_set_graphics_mode(int mode);
+void draw_begin(int bufferId);
+void draw_end(void);
+void draw_pixel(int paletteIndex, int x, int y);
+void draw_tile(int tileId, int x, int y);
+void draw_sprite(int tileId, int x, int y);
+void draw_textbox(int x, int y);
+void draw_clear(int paletteIndex);
+uint32_t tile_signature(int tileId);
+
+/* DRAW LIST */
+#define DRAW_CMD_GRAPHICS_MODE 1 /* mode */
+#define DRAW_CMD_BEGIN 2         /* bufferId */
+#define DRAW_CMD_END 3
+#define DRAW_CMD_PIXEL 4         /* paletteIndex, x, y */
+#define DRAW_CMD_TILE 5          /* tileId, x, y */
+#define DRAW_CMD_TEXTBOX 6       /* x, y */
+#define DRAW_CMD_CLEAR 7         /* paletteIndex */
+#define DRAW_CMD_ROOM 8
+#define DRAW_CMD_SPRITE 9        /* tileId, x, y */
+#define DRAW_CMD_WORDS 4         /* Every command is four int16: opcode and up to three arguments */
+
+duk_ret_t bitsy_draw_commands(duk_context *ctx);
+void log_draw_stats(int frameCount);
+
+/* FONT */
+bool init_font(const char *filepath);
+void deinit_font(void);
+bool font_push_header(duk_context *ctx);
+bool draw_char(uint32_t code, int x, int y, int paletteIndex);
+duk_ret_t bitsy_draw_char(duk_context *ctx);
+duk_ret_t bitsy_get_font_char(duk_context *ctx);
+
+/* ROOM */
+bool init_room(void);
+void deinit_room(void);
+void room_reset(void);
+void draw_room(void);
+void log_room_stats(void);
+duk_ret_t bitsy_set_room_tiles(duk_context *ctx);
+duk_ret_t bitsy_draw_room(duk_context *ctx);
+duk_ret_t bitsy_get_room_cache_stats(duk_context *ctx);
+
+/* PRESENT */
+bool init_present(void);
+void deinit_present(void);
+uint32_t present_new_signature(void);
+void present_mark_dirty(int x, int y, int w, int h);
+void present_mark_tile(int tileX, int tileY, uint32_t signature);
+void present_mark_clear(uint32_t signature);
+uint32_t present_get_cell(int cellX, int cellY);
+void present_set_cell(int cellX, int cellY, uint32_t signature);
+void present_invalidate(void);
+void present_set_override(const bitsy_color_t *frame);
+void present_show_textbox(int x, int y);
+void present_hide_textbox(void);
+void present_textbox_changed(void);
+void present_compose_textbox(bitsy_pixel_t *dst, int dstStride, int x, int y, int w, int h);
+void present_frame(void);
+
+/* BLIT */
+void blit_fill(bitsy_pixel_t *dst, bitsy_pixel_t value, int count);
+void blit_copy_row(bitsy_pixel_t *dst, const bitsy_pixel_t *src, int count);
+void blit_copy_rect_1x(bitsy_pixel_t *dst, int dstStride, const bitsy_pixel_t *src, int srcStride, int w, int h);
+void blit_copy_rect_2x(bitsy_pixel_t *dst, int dstStride, const bitsy_pixel_t *src, int srcStride, int w, int h);
+void blit_copy_rect_nx(bitsy_pixel_t *dst, int dstStride, const bitsy_pixel_t *src, int srcStride, int w, int h, int scale);
+void blit_fill_rect(bitsy_pixel_t *dst, int dstStride, bitsy_pixel_t value, int w, int h);
+
+/* Copy only the pixels set in rowMasks (one byte per row, bit 0 first, w <= 8), scaled up */
+void blit_copy_rect_masked(bitsy_pixel_t *dst, int dstStride, const bitsy_pixel_t *src, int srcStride,
+                           const uint8_t *rowMasks, int w, int h, int scale);
+
+/* Copy a w x h block scaled up by an integer factor; constant scales pick their kernel at compile time */
+static inline void blit_copy_rect(bitsy_pixel_t *dst, int dstStride, const bitsy_pixel_t *src, int srcStride, int w, int h, int scale)
+{
+    if (scale == 1) {
+        blit_copy_rect_1x(dst, dstStride, src, srcStride, w, h);
+    }
+    else if (scale == 2) {
+        blit_copy_rect_2x(dst, dstStride, src, srcStride, w, h);
+    }
+    else {
+        blit_copy_rect_nx(dst, dstStride, src, srcStride, w, h, scale);
+    }
+}
+
+/* TILE ATLAS */
+bool init_tile_atlas(void);
+void deinit_tile_atlas(void);
+int tile_atlas_alloc(void);
+void tile_atlas_reset(void);
+bool tile_atlas_contains(int tileId);
+void tile_atlas_log_usage(void);
+
+static inline bitsy_pixel_t *tile_atlas_pixels(int tileId)
+{
+    return &tileAtlas[(tileId - TILE_ATLAS_FIRST_ID) * TILE_PIXEL_COUNT];
+}
+
+/* TRANSITION */
+duk_ret_t bitsy_begin_transition(duk_context *ctx);
+duk_ret_t bitsy_is_transition_active(duk_context *ctx);
+bool update_transition(duk_context *ctx);
+void deinit_transition(void);
+
+/* WORLD CACHE */
+void world_cache_set_engine(const char *const *paths, int count);
+void world_cache_set_game(const char *path, const char *data, size_t length);
+bool world_cache_was_hit(void);
+duk_ret_t bitsy_load_world_cache(duk_context *ctx);
+duk_ret_t bitsy_save_world_cache(duk_context *ctx);
+
+/* GAME DATA */
+bool init_game_data(const char *filepath);
+void deinit_game_data(void);
+bool game_data_push_header(duk_context *ctx);
+duk_ret_t bitsy_get_game_sections(duk_context *ctx);
+duk_ret_t bitsy_get_game_section(duk_context *ctx);
+
 /* APP */
 void app_duktape_bitsy();
 
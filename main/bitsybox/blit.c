@@ -0,0 +1,211 @@
+#include "bitsybox.h"
+
+// Word access to pixel buffers of either pixel type
+typedef uint32_t __attribute__((__may_alias__)) blit_word_t;
+
+#define BLIT_WORD_PIXELS (int)(sizeof(blit_word_t) / sizeof(bitsy_pixel_t))
+#define BLIT_WORD_ALIGNED(ptr) ((((uintptr_t)(ptr)) & (sizeof(blit_word_t) - 1)) == 0)
+
+// A word filled with copies of one pixel
+static inline uint32_t blit_pattern(bitsy_pixel_t value)
+{
+#if INDEXED_FRAMEBUFFER
+    return value * 0x01010101u;
+#else
+    return value * 0x00010001u;
+#endif
+}
+
+void blit_fill(bitsy_pixel_t *dst, bitsy_pixel_t value, int count)
+{
+    // Single pixels up to the first word boundary
+    while (count > 0 && !BLIT_WORD_ALIGNED(dst)) {
+        *dst++ = value;
+        count--;
+    }
+
+    blit_word_t pattern = blit_pattern(value);
+    blit_word_t *words = (blit_word_t *)dst;
+    int wordCount = count / BLIT_WORD_PIXELS;
+
+    int i = 0;
+    for (; i + 4 <= wordCount; i += 4) {
+        words[i] = pattern;
+        words[i + 1] = pattern;
+        words[i + 2] = pattern;
+        words[i + 3] = pattern;
+    }
+    for (; i < wordCount; i++) {
+        words[i] = pattern;
+    }
+
+    // Remaining pixels after the last whole word
+    dst += wordCount * BLIT_WORD_PIXELS;
+    count -= wordCount * BLIT_WORD_PIXELS;
+    while (count-- > 0) {
+        *dst++ = value;
+    }
+}
+
+void blit_copy_row(bitsy_pixel_t *dst, const bitsy_pixel_t *src, int count)
+{
+    // The libc memcpy already moves aligned data a word at a time
+    memcpy(dst, src, count * sizeof(bitsy_pixel_t));
+}
+
+// Every source pixel written twice, one word per source word half
+static void blit_copy_row_2x(bitsy_pixel_t *dst, const bitsy_pixel_t *src, int count)
+{
+    int i = 0;
+
+    if (BLIT_WORD_ALIGNED(dst)) {
+        blit_word_t *words = (blit_word_t *)dst;
+#if INDEXED_FRAMEBUFFER
+        // Two source pixels become one word: a a b b
+        for (; i + 2 <= count; i += 2) {
+            uint32_t a = src[i];
+            uint32_t b = src[i + 1];
+            *words++ = a | (a << 8) | (b << 16) | (b << 24);
+        }
+#else
+        for (; i < count; i++) {
+            *words++ = blit_pattern(src[i]);
+        }
+#endif
+        dst = (bitsy_pixel_t *)words;
+    }
+
+    for (; i < count; i++) {
+        *dst++ = src[i];
+        *dst++ = src[i];
+    }
+}
+
+static void blit_copy_row_nx(bitsy_pixel_t *dst, const bitsy_pixel_t *src, int count, int scale)
+{
+    for (int i = 0; i < count; i++) {
+        blit_fill(dst, src[i], scale);
+        dst += scale;
+    }
+}
+
+void blit_copy_rect_1x(bitsy_pixel_t *dst, int dstStride, const bitsy_pixel_t *src, int srcStride, int w, int h)
+{
+    // Contiguous rows are one block
+    if (dstStride == w && srcStride == w) {
+        blit_copy_row(dst, src, w * h);
+        return;
+    }
+
+    for (int y = 0; y < h; y++) {
+        blit_copy_row(dst, src, w);
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+
+void blit_copy_rect_2x(bitsy_pixel_t *dst, int dstStride, const bitsy_pixel_t *src, int srcStride, int w, int h)
+{
+    for (int y = 0; y < h; y++) {
+        blit_copy_row_2x(dst, src, w);
+        blit_copy_row(dst + dstStride, dst, w * 2);
+        dst += dstStride * 2;
+        src += srcStride;
+    }
+}
+
+void blit_copy_rect_nx(bitsy_pixel_t *dst, int dstStride, const bitsy_pixel_t *src, int srcStride, int w, int h, int scale)
+{
+    for (int y = 0; y < h; y++) {
+        blit_copy_row_nx(dst, src, w, scale);
+        // The other rows of the scaled pixel row are copies of the first
+        for (int j = 1; j < scale; j++) {
+            blit_copy_row(dst + j * dstStride, dst, w * scale);
+        }
+        dst += dstStride * scale;
+        src += srcStride;
+    }
+}
+
+// Word with the pixel lanes selected by one mask bit each set, bit 0 is the first pixel in memory
+static const uint32_t blitLaneMasks[1 << BLIT_WORD_PIXELS] = {
+#if INDEXED_FRAMEBUFFER
+    0x00000000, 0x000000FF, 0x0000FF00, 0x0000FFFF, 0x00FF0000, 0x00FF00FF, 0x00FFFF00, 0x00FFFFFF,
+    0xFF000000, 0xFF0000FF, 0xFF00FF00, 0xFF00FFFF, 0xFFFF0000, 0xFFFF00FF, 0xFFFFFF00, 0xFFFFFFFF,
+#else
+    0x00000000, 0x0000FFFF, 0xFFFF0000, 0xFFFFFFFF,
+#endif
+};
+
+#define BLIT_LANES_ALL ((1u << BLIT_WORD_PIXELS) - 1)
+
+// Only the pixels whose mask bit is set, a word at a time where both rows allow it
+static void blit_copy_row_masked(bitsy_pixel_t *dst, const bitsy_pixel_t *src, uint32_t mask, int count)
+{
+    int i = 0;
+
+    if (BLIT_WORD_ALIGNED(dst) && BLIT_WORD_ALIGNED(src)) {
+        blit_word_t *dstWords = (blit_word_t *)dst;
+        const blit_word_t *srcWords = (const blit_word_t *)src;
+        for (; i + BLIT_WORD_PIXELS <= count; i += BLIT_WORD_PIXELS, dstWords++, srcWords++) {
+            uint32_t lanes = (mask >> i) & BLIT_LANES_ALL;
+            if (lanes == 0) {
+                continue;
+            }
+            if (lanes == BLIT_LANES_ALL) {
+                *dstWords = *srcWords;
+                continue;
+            }
+            uint32_t select = blitLaneMasks[lanes];
+            *dstWords = (*dstWords & ~select) | (*srcWords & select);
+        }
+    }
+
+    for (; i < count; i++) {
+        if (mask & (1u << i)) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+void blit_copy_rect_masked(bitsy_pixel_t *dst, int dstStride, const bitsy_pixel_t *src, int srcStride,
+                           const uint8_t *rowMasks, int w, int h, int scale)
+{
+    uint32_t opaqueRow = (1u << w) - 1;
+
+    for (int y = 0; y < h; y++, dst += dstStride * scale, src += srcStride) {
+        uint32_t mask = rowMasks[y] & opaqueRow;
+        if (mask == 0) {
+            continue;
+        }
+
+        if (scale == 1) {
+            if (mask == opaqueRow) {
+                blit_copy_row(dst, src, w);
+            }
+            else {
+                blit_copy_row_masked(dst, src, mask, w);
+            }
+            continue;
+        }
+
+        for (int x = 0; x < w; x++) {
+            if (mask & (1u << x)) {
+                blit_fill_rect(dst + x * scale, dstStride, src[x], scale, scale);
+            }
+        }
+    }
+}
+
+void blit_fill_rect(bitsy_pixel_t *dst, int dstStride, bitsy_pixel_t value, int w, int h)
+{
+    if (dstStride == w) {
+        blit_fill(dst, value, w * h);
+        return;
+    }
+
+    for (int y = 0; y < h; y++) {
+        blit_fill(dst, value, w);
+        dst += dstStride;
+    }
+}
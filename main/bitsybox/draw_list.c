@@ -0,0 +1,128 @@
+#include "bitsybox.h"
+#include "esp_timer.h"
+
+static const char *TAG = "DrawList";
+
+// Display list stats, reset by log_draw_stats
+static int drawListCallCount = 0;
+static int drawListCommandCount = 0;
+static int64_t drawListTimeTotal = 0;
+
+// Number of int16 arguments each opcode uses, -1 for unknown opcodes
+static int draw_command_arg_count(int opcode)
+{
+    switch (opcode) {
+    case DRAW_CMD_END:
+    case DRAW_CMD_ROOM:
+        return 0;
+    case DRAW_CMD_GRAPHICS_MODE:
+    case DRAW_CMD_BEGIN:
+    case DRAW_CMD_CLEAR:
+        return 1;
+    case DRAW_CMD_TEXTBOX:
+        return 2;
+    case DRAW_CMD_PIXEL:
+    case DRAW_CMD_TILE:
+    case DRAW_CMD_SPRITE:
+        return 3;
+    default:
+        return -1;
+    }
+}
+
+static bool validate_draw_command(const int16_t *cmd)
+{
+    if (draw_command_arg_count(cmd[0]) < 0) {
+        return false;
+    }
+
+    // Palette indices index straight into the system palette
+    if (cmd[0] == DRAW_CMD_PIXEL || cmd[0] == DRAW_CMD_CLEAR) {
+        return cmd[1] >= 0 && cmd[1] < SYSTEM_PALETTE_MAX;
+    }
+
+    return true;
+}
+
+// bitsyDrawCommands(buffer, commandCount): buffer is any Duktape buffer or typed array (e.g. an
+// Int16Array) of DRAW_CMD_WORDS words per command. commandCount defaults to the whole buffer.
+// The whole list is validated first, so a malformed list draws nothing. Coordinates are
+// checked against the target buffer by each draw call, off-target pixels and tiles are dropped.
+duk_ret_t bitsy_draw_commands(duk_context *ctx)
+{
+    int64_t startTime = esp_timer_get_time();
+
+    duk_size_t size = 0;
+    const int16_t *commands = duk_get_buffer_data(ctx, 0, &size);
+    // Whole int16 commands only, and aligned for the cast
+    if (commands == NULL || size % (DRAW_CMD_WORDS * sizeof(int16_t)) != 0 || (uintptr_t)commands % sizeof(int16_t) != 0) {
+        return DUK_RET_TYPE_ERROR;
+    }
+
+    int available = size / (DRAW_CMD_WORDS * sizeof(int16_t));
+    int count = duk_get_int_default(ctx, 1, available);
+    if (count < 0 || count > available) {
+        return DUK_RET_RANGE_ERROR;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!validate_draw_command(&commands[i * DRAW_CMD_WORDS])) {
+            ESP_LOGE(TAG, "Invalid draw command %d (opcode %d)", i, commands[i * DRAW_CMD_WORDS]);
+            return DUK_RET_RANGE_ERROR;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        const int16_t *cmd = &commands[i * DRAW_CMD_WORDS];
+
+        switch (cmd[0]) {
+        case DRAW_CMD_GRAPHICS_MODE:
+            draw_set_graphics_mode(cmd[1]);
+            break;
+        case DRAW_CMD_BEGIN:
+            draw_begin(cmd[1]);
+            break;
+        case DRAW_CMD_END:
+            draw_end();
+            break;
+        case DRAW_CMD_PIXEL:
+            draw_pixel(cmd[1], cmd[2], cmd[3]);
+            break;
+        case DRAW_CMD_TILE:
+            draw_tile(cmd[1], cmd[2], cmd[3]);
+            break;
+        case DRAW_CMD_SPRITE:
+            draw_sprite(cmd[1], cmd[2], cmd[3]);
+            break;
+        case DRAW_CMD_TEXTBOX:
+            draw_textbox(cmd[1], cmd[2]);
+            break;
+        case DRAW_CMD_CLEAR:
+            draw_clear(cmd[1]);
+            break;
+        case DRAW_CMD_ROOM:
+            draw_room();
+            break;
+        }
+    }
+
+    drawListCallCount++;
+    drawListCommandCount += count;
+    drawListTimeTotal += esp_timer_get_time() - startTime;
+
+    return 0;
+}
+
+void log_draw_stats(int frameCount)
+{
+    if (frameCount > 0) {
+        ESP_LOGI(TAG, "Draw: %d single calls/frame, %d lists/frame with %d commands/frame, %" PRId64 " us/frame in lists",
+                 drawCallCount / frameCount, drawListCallCount / frameCount, drawListCommandCount / frameCount,
+                 drawListTimeTotal / frameCount);
+    }
+
+    drawCallCount = 0;
+    drawListCallCount = 0;
+    drawListCommandCount = 0;
+    drawListTimeTotal = 0;
+}
@@ -0,0 +1,250 @@
+#include "bitsybox.h"
+#include <string.h>
+#include "assets.h"
+
+static const char *TAG = "Font";
+
+// Binary font made by utils/convert_font.py from a .bitsyfont: a header, an index of glyphs
+// sorted by char code, then the packed 1-bit bitmaps, rows padded to whole bytes, MSB first.
+// The font is used in place, straight from the mapped asset partition.
+#define FONT_MAGIC "BFNT"
+#define FONT_VERSION 1
+#define FONT_NAME_SIZE 16
+
+typedef struct
+{
+    char magic[4];
+    uint8_t version;
+    uint8_t width;
+    uint8_t height;
+    uint8_t reserved0;
+    uint16_t glyphCount;
+    uint16_t reserved1;
+    uint32_t bitsSize;
+    char name[FONT_NAME_SIZE];
+} font_header_t;
+
+typedef struct
+{
+    uint32_t code;
+    uint32_t bitsOffset;
+    uint8_t width;
+    uint8_t height;
+    int8_t offsetX;
+    int8_t offsetY;
+    uint8_t spacing;
+    uint8_t reserved[3];
+} font_glyph_t;
+
+_Static_assert(sizeof(font_header_t) == 32, "font header must match utils/convert_font.py");
+_Static_assert(sizeof(font_glyph_t) == 16, "font glyph must match utils/convert_font.py");
+
+#define FONT_ROW_BYTES(width) (((width) + 7) / 8)
+
+// Glyph index of each ASCII character, -1 when the font doesn't have it
+#define FONT_ASCII_MAX 128
+
+static const uint8_t *fontData = NULL;
+static const font_header_t *fontHeader = NULL;
+static const font_glyph_t *fontGlyphs = NULL;
+static int fontGlyphCount = 0;
+static const uint8_t *fontBits = NULL;
+static int16_t fontAscii[FONT_ASCII_MAX];
+
+static const font_glyph_t *find_glyph(uint32_t code)
+{
+    if (code < FONT_ASCII_MAX) {
+        return fontAscii[code] >= 0 ? &fontGlyphs[fontAscii[code]] : NULL;
+    }
+
+    int low = 0;
+    int high = fontGlyphCount - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (fontGlyphs[mid].code == code) {
+            return &fontGlyphs[mid];
+        }
+        if (fontGlyphs[mid].code < code) {
+            low = mid + 1;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+
+    return NULL;
+}
+
+static void build_ascii_table(void)
+{
+    for (int i = 0; i < FONT_ASCII_MAX; i++) {
+        fontAscii[i] = -1;
+    }
+    for (int i = 0; i < fontGlyphCount && fontGlyphs[i].code < FONT_ASCII_MAX; i++) {
+        fontAscii[fontGlyphs[i].code] = i;
+    }
+}
+
+// Check that the index and every bitmap it points at are inside the file
+static bool validate_font(size_t length)
+{
+    if (length < sizeof(font_header_t) || memcmp(fontHeader->magic, FONT_MAGIC, 4) != 0) {
+        ESP_LOGE(TAG, "Not a binary font");
+        return false;
+    }
+    if (fontHeader->version != FONT_VERSION) {
+        ESP_LOGE(TAG, "Unsupported font version %d", fontHeader->version);
+        return false;
+    }
+
+    size_t indexSize = fontHeader->glyphCount * sizeof(font_glyph_t);
+    if (sizeof(font_header_t) + indexSize + fontHeader->bitsSize > length) {
+        ESP_LOGE(TAG, "Font file is truncated");
+        return false;
+    }
+
+    const font_glyph_t *glyphs = (const font_glyph_t *)(fontData + sizeof(font_header_t));
+    for (int i = 0; i < fontHeader->glyphCount; i++) {
+        uint32_t glyphSize = glyphs[i].height * FONT_ROW_BYTES(glyphs[i].width);
+        if (glyphs[i].bitsOffset > fontHeader->bitsSize || glyphSize > fontHeader->bitsSize - glyphs[i].bitsOffset) {
+            ESP_LOGE(TAG, "Glyph %" PRIu32 " is out of bounds", glyphs[i].code);
+            return false;
+        }
+        if (i > 0 && glyphs[i].code <= glyphs[i - 1].code) {
+            ESP_LOGE(TAG, "Glyph index is not sorted");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void deinit_font(void)
+{
+    // Nothing to free, the font belongs to the asset partition
+    fontData = NULL;
+    fontHeader = NULL;
+    fontGlyphs = NULL;
+    fontBits = NULL;
+    fontGlyphCount = 0;
+}
+
+bool init_font(const char *filepath)
+{
+    deinit_font();
+
+    size_t length = 0;
+    if (!vgc_assets_get(filepath, &fontData, &length)) {
+        ESP_LOGE(TAG, "Failed to open font file: %s", filepath);
+        return false;
+    }
+
+    fontHeader = (const font_header_t *)fontData;
+    if (!validate_font(length)) {
+        deinit_font();
+        return false;
+    }
+
+    fontGlyphs = (const font_glyph_t *)(fontData + sizeof(font_header_t));
+    fontGlyphCount = fontHeader->glyphCount;
+    fontBits = (const uint8_t *)&fontGlyphs[fontGlyphCount];
+    build_ascii_table();
+
+    ESP_LOGI(TAG, "Font %.*s: %d glyphs, %" PRIu32 " bytes of bitmaps",
+             FONT_NAME_SIZE, fontHeader->name, fontGlyphCount, fontHeader->bitsSize);
+
+    return true;
+}
+
+// The font header as .bitsyfont text, for the engine when it no longer gets the whole font
+bool font_push_header(duk_context *ctx)
+{
+    if (fontHeader == NULL) {
+        return false;
+    }
+
+    duk_push_sprintf(ctx, "FONT %.*s\nSIZE %d %d\n", FONT_NAME_SIZE, fontHeader->name, fontHeader->width, fontHeader->height);
+    return true;
+}
+
+// Blit a glyph into the textbox buffer. x and y already include the text effect offset of the
+// character, the glyph's own offset from the font is added here.
+bool draw_char(uint32_t code, int x, int y, int paletteIndex)
+{
+    const font_glyph_t *glyph = find_glyph(code);
+    if (glyph == NULL) {
+        return false;
+    }
+
+    // Can only draw text into the textbox buffer in tile mode
+    if (curBufferId != TEXTBOX_BUFFER_ID || curGraphicsMode != 1) {
+        return true;
+    }
+
+    bitsy_pixel_t color = BITSY_PIXEL(paletteIndex);
+    bitsy_pixel_t *textbox = drawingBuffers[TEXTBOX_BUFFER_ID];
+    const uint8_t *bits = &fontBits[glyph->bitsOffset];
+    int rowBytes = FONT_ROW_BYTES(glyph->width);
+
+    int originX = x + glyph->offsetX;
+    int originY = y + glyph->offsetY;
+
+    for (int row = 0; row < glyph->height; row++, bits += rowBytes) {
+        int py = originY + row;
+        if (py < 0 || py >= textboxHeight) {
+            continue;
+        }
+
+        for (int col = 0; col < glyph->width; col++) {
+            int px = originX + col;
+            if ((bits[col / 8] & (0x80 >> (col % 8))) == 0 || px < 0 || px >= textboxWidth) {
+                continue;
+            }
+
+            blit_fill_rect(&textbox[py * TEXTBOX_RENDER_SCALE * textboxWidth + px * TEXTBOX_RENDER_SCALE], textboxWidth,
+                           color, TEXTBOX_RENDER_SCALE, TEXTBOX_RENDER_SCALE);
+        }
+    }
+    present_textbox_changed();
+
+    return true;
+}
+
+// bitsyDrawChar(charCode, x, y, color): draws one glyph into the textbox in one call.
+// Returns false if the native font has no such glyph, so the caller can fall back.
+duk_ret_t bitsy_draw_char(duk_context *ctx)
+{
+    drawCallCount++;
+
+    int paletteIndex = duk_get_int(ctx, 3);
+    if (paletteIndex < 0 || paletteIndex >= SYSTEM_PALETTE_MAX) {
+        return DUK_RET_RANGE_ERROR;
+    }
+
+    duk_push_boolean(ctx, draw_char(duk_get_uint(ctx, 0), duk_get_int(ctx, 1), duk_get_int(ctx, 2), paletteIndex));
+    return 1;
+}
+
+// bitsyGetFontChar(charCode): { width, height, offsetX, offsetY, spacing } of a native glyph,
+// or null if the font doesn't have it, so the engine can lay out text without the font data
+duk_ret_t bitsy_get_font_char(duk_context *ctx)
+{
+    const font_glyph_t *glyph = find_glyph(duk_get_uint(ctx, 0));
+    if (glyph == NULL) {
+        duk_push_null(ctx);
+        return 1;
+    }
+
+    duk_push_object(ctx);
+    duk_push_int(ctx, glyph->width);
+    duk_put_prop_string(ctx, -2, "width");
+    duk_push_int(ctx, glyph->height);
+    duk_put_prop_string(ctx, -2, "height");
+    duk_push_int(ctx, glyph->offsetX);
+    duk_put_prop_string(ctx, -2, "offsetX");
+    duk_push_int(ctx, glyph->offsetY);
+    duk_put_prop_string(ctx, -2, "offsetY");
+    duk_push_int(ctx, glyph->spacing);
+    duk_put_prop_string(ctx, -2, "spacing");
+    return 1;
+}
@@ -0,0 +1,282 @@
+#include "bitsybox.h"
+#include <string.h>
+#include "esp_timer.h"
+#include "assets.h"
+
+static const char *TAG = "GameData";
+
+// Sections of a .bitsy file start on the line after a blank line with one of these keywords,
+// the rest of that line is the section id. Blank lines inside a """ dialog block don't count.
+static const char *sectionNames[] = {"PAL", "ROOM", "SET", "TIL", "SPR", "ITM", "DLG", "END", "VAR", "TUNE", "BLIP"};
+#define SECTION_TYPE_COUNT (int)(sizeof(sectionNames) / sizeof(sectionNames[0]))
+#define SECTION_QUOTE "\"\"\""
+
+typedef struct
+{
+    uint8_t type;
+    bool fetched;
+    uint16_t idLength;
+    uint32_t idOffset;
+    uint32_t offset;
+    uint32_t length;
+} game_section_t;
+
+// The game text stays outside the Duktape heap: in place in the mapped asset partition when it
+// is stored uncompressed, otherwise decompressed once into PSRAM
+static const char *gameText = NULL;
+static char *gameTextBuffer = NULL;
+static size_t gameTextLength = 0;
+static size_t gameHeaderLength = 0;
+
+static game_section_t *sections = NULL;
+static int sectionCount = 0;
+static int sectionCapacity = 0;
+
+static int fetchedCount = 0;
+static size_t fetchedBytes = 0;
+
+static int find_section_type(const char *name, size_t length)
+{
+    for (int type = 0; type < SECTION_TYPE_COUNT; type++) {
+        if (strlen(sectionNames[type]) == length && memcmp(sectionNames[type], name, length) == 0) {
+            return type;
+        }
+    }
+
+    return -1;
+}
+
+static bool add_section(int type, size_t offset, size_t idOffset, size_t idLength)
+{
+    if (sectionCount == sectionCapacity) {
+        int capacity = sectionCapacity ? sectionCapacity * 2 : 64;
+        game_section_t *grown = heap_caps_realloc(sections, capacity * sizeof(game_section_t), MALLOC_CAP_SPIRAM);
+        if (grown == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate memory for the game index");
+            return false;
+        }
+        sections = grown;
+        sectionCapacity = capacity;
+    }
+
+    game_section_t *section = &sections[sectionCount++];
+    section->type = type;
+    section->fetched = false;
+    section->idLength = idLength;
+    section->idOffset = idOffset;
+    section->offset = offset;
+    section->length = 0;
+    return true;
+}
+
+// One pass over the text, line by line. A section ends at its last non blank line.
+static bool build_index(void)
+{
+    size_t pos = 0;
+    size_t contentEnd = 0;
+    bool previousBlank = false; // The title line never starts a section
+    bool inQuote = false;
+    game_section_t *current = NULL;
+
+    while (pos < gameTextLength) {
+        const char *newline = memchr(gameText + pos, '\n', gameTextLength - pos);
+        size_t next = newline ? (size_t)(newline - gameText) + 1 : gameTextLength;
+        size_t end = newline ? (size_t)(newline - gameText) : gameTextLength;
+        if (end > pos && gameText[end - 1] == '\r') {
+            end--;
+        }
+
+        const char *line = gameText + pos;
+        size_t lineLength = end - pos;
+        bool blank = lineLength == 0;
+        bool quote = lineLength == 3 && memcmp(line, SECTION_QUOTE, 3) == 0;
+
+        if (quote) {
+            inQuote = !inQuote;
+        }
+        else if (!inQuote && previousBlank && !blank) {
+            const char *space = memchr(line, ' ', lineLength);
+            size_t nameLength = space ? (size_t)(space - line) : lineLength;
+            int type = find_section_type(line, nameLength);
+
+            if (type >= 0) {
+                if (current != NULL) {
+                    current->length = contentEnd - current->offset;
+                }
+                else {
+                    gameHeaderLength = contentEnd;
+                }
+
+                size_t idOffset = space ? pos + nameLength + 1 : end;
+                if (!add_section(type, pos, idOffset, end - idOffset)) {
+                    return false;
+                }
+                current = &sections[sectionCount - 1];
+            }
+        }
+
+        if (!blank) {
+            contentEnd = end;
+        }
+        previousBlank = blank;
+        pos = next;
+    }
+
+    if (current != NULL) {
+        current->length = contentEnd - current->offset;
+    }
+    else {
+        gameHeaderLength = contentEnd;
+    }
+
+    return true;
+}
+
+static bool read_game_text(const char *filepath)
+{
+    vgc_asset_reader_t reader;
+    if (!vgc_assets_open(filepath, &reader)) {
+        return false;
+    }
+
+    if (reader.decoder == NULL) {
+        gameText = (const char *)reader.data;
+        gameTextLength = reader.size;
+        vgc_assets_close(&reader);
+        return true;
+    }
+
+    gameTextBuffer = heap_caps_malloc(reader.rawSize, MALLOC_CAP_SPIRAM);
+    if (gameTextBuffer == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate memory for the game text");
+        vgc_assets_close(&reader);
+        return false;
+    }
+
+    size_t length = 0;
+    int count;
+    while ((count = vgc_assets_read(&reader, gameTextBuffer + length, reader.rawSize - length)) > 0) {
+        length += count;
+    }
+    vgc_assets_close(&reader);
+
+    if (count < 0 || length != reader.rawSize) {
+        ESP_LOGE(TAG, "Failed to read game data: %s", filepath);
+        heap_caps_free(gameTextBuffer);
+        gameTextBuffer = NULL;
+        return false;
+    }
+
+    gameText = gameTextBuffer;
+    gameTextLength = length;
+    return true;
+}
+
+void deinit_game_data(void)
+{
+    if (sectionCount > 0) {
+        ESP_LOGI(TAG, "Materialized %d of %d sections, %u of %u bytes",
+                 fetchedCount, sectionCount, (unsigned)fetchedBytes, (unsigned)gameTextLength);
+    }
+
+    if (sections != NULL) {
+        heap_caps_free(sections);
+        sections = NULL;
+    }
+    if (gameTextBuffer != NULL) {
+        heap_caps_free(gameTextBuffer);
+        gameTextBuffer = NULL;
+    }
+    gameText = NULL;
+    gameTextLength = 0;
+    gameHeaderLength = 0;
+    sectionCount = 0;
+    sectionCapacity = 0;
+    fetchedCount = 0;
+    fetchedBytes = 0;
+}
+
+bool init_game_data(const char *filepath)
+{
+    deinit_game_data();
+
+    int64_t startTime = esp_timer_get_time();
+
+    if (!read_game_text(filepath)) {
+        return false;
+    }
+
+    if (!build_index()) {
+        deinit_game_data();
+        return false;
+    }
+
+    // The parsed world cache is keyed by the game text
+    world_cache_set_game(filepath, gameText, gameTextLength);
+
+    ESP_LOGI(TAG, "Indexed %d sections of %s in %" PRId64 " us, header %u bytes, text %u bytes in %s",
+             sectionCount, filepath, esp_timer_get_time() - startTime, (unsigned)gameHeaderLength,
+             (unsigned)gameTextLength, gameTextBuffer ? "PSRAM" : "flash");
+
+    return true;
+}
+
+// The lines before the first section: title, version and settings
+bool game_data_push_header(duk_context *ctx)
+{
+    if (gameText == NULL) {
+        return false;
+    }
+
+    duk_push_lstring(ctx, gameText, gameHeaderLength);
+    return true;
+}
+
+// bitsyGetGameSections(type): ids of every section of a type ("ROOM", "TIL", "DLG"...) in file
+// order, so the engine knows what exists without parsing any of it
+duk_ret_t bitsy_get_game_sections(duk_context *ctx)
+{
+    duk_size_t nameLength = 0;
+    const char *name = duk_get_lstring(ctx, 0, &nameLength);
+    int type = find_section_type(name, nameLength);
+
+    duk_push_array(ctx);
+    int index = 0;
+    for (int i = 0; i < sectionCount; i++) {
+        if (sections[i].type == type) {
+            duk_push_lstring(ctx, gameText + sections[i].idOffset, sections[i].idLength);
+            duk_put_prop_index(ctx, -2, index++);
+        }
+    }
+    return 1;
+}
+
+// bitsyGetGameSection(type, id): the text of one section, keyword line included, or null.
+// The engine parses it the first time it touches the room, drawing or dialog.
+duk_ret_t bitsy_get_game_section(duk_context *ctx)
+{
+    duk_size_t nameLength = 0;
+    const char *name = duk_get_lstring(ctx, 0, &nameLength);
+    duk_size_t idLength = 0;
+    const char *id = duk_to_lstring(ctx, 1, &idLength);
+    int type = find_section_type(name, nameLength);
+
+    for (int i = 0; i < sectionCount; i++) {
+        game_section_t *section = &sections[i];
+        if (section->type != type || section->idLength != idLength || memcmp(gameText + section->idOffset, id, idLength) != 0) {
+            continue;
+        }
+
+        if (!section->fetched) {
+            section->fetched = true;
+            fetchedCount++;
+            fetchedBytes += section->length;
+        }
+
+        duk_push_lstring(ctx, gameText + section->offset, section->length);
+        return 1;
+    }
+
+    duk_push_null(ctx);
+    return 1;
+}
@@ -0,0 +1,681 @@
+#include "bitsybox.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "display.h"
+
+static const char *TAG = "Present";
+
+// Number of presented frames between two timing reports
+#define PRESENT_STATS_INTERVAL 120
+
+// Dirty tracking works on screen cells, one per room tile
+#define PRESENT_CELL_SIZE (TILE_SIZE * RENDER_SCALE)
+#define PRESENT_CELLS (SCREEN_SIZE / PRESENT_CELL_SIZE)
+
+// One buffer is filled while the panel reads the other
+#define PRESENT_BUFFER_COUNT 2
+
+// Past this many rectangles the per transfer overhead outweighs the saved pixels
+#define PRESENT_MAX_RECTS 16
+
+// Frames submitted by the game loop and not yet composed, a power of two
+#define PRESENT_QUEUE_LENGTH 2
+
+#define PRESENT_TASK_STACK_SIZE 4096
+#define PRESENT_TASK_PRIORITY 5
+
+typedef struct
+{
+    int x;
+    int y;
+    int w;
+    int h;
+} present_rect_t;
+
+// Signature of what was drawn into each cell of the screen buffer, and of what the panel shows
+static uint32_t cellSignatures[PRESENT_CELLS * PRESENT_CELLS];
+static uint32_t presentedSignatures[PRESENT_CELLS * PRESENT_CELLS];
+
+// One bit per cell whose content differs from what the panel shows
+static uint32_t dirtyTiles[PRESENT_CELLS];
+
+// Set when everything has to go out, e.g. after a palette change
+static bool forceFullPresent = true;
+
+// Full frame of panel colors shown instead of the screen buffer, e.g. during transitions
+static const bitsy_color_t *overrideFrame = NULL;
+
+static uint32_t nextSignature = 1;
+
+// The textbox is an overlay composited over the screen buffer at present time, so the screen
+// under it keeps the room. Every update showing the textbox places it again.
+typedef struct
+{
+    bool visible;
+    int x;
+    int y;
+    int w;
+    int h;
+    uint32_t signature;
+} present_textbox_t;
+
+static present_textbox_t textbox;
+static present_textbox_t presentedTextbox;
+
+// The engine may redraw the textbox every update, so its signature is a hash of the content,
+// taken at present time and only after something was drawn into it
+static uint32_t textboxSignature = 0;
+static bool textboxContentChanged = true;
+
+// Frame handed from the game loop to the compositor
+typedef struct
+{
+    present_rect_t rects[PRESENT_MAX_RECTS];
+    int rectCount;
+    // Rectangles packed back to back: screen pixels, or panel colors when isOverride is set
+    void *pixels;
+    bool isOverride;
+#if INDEXED_FRAMEBUFFER
+    bitsy_color_t palette[SYSTEM_PALETTE_MAX];
+#endif
+    int64_t submitTime;
+} present_slot_t;
+
+// Single producer (game loop), single consumer (compositor) ring. Each side only writes its
+// own index, so handing off a frame needs no lock.
+static present_slot_t presentQueue[PRESENT_QUEUE_LENGTH];
+static uint32_t queueHead = 0;
+static uint32_t queueTail = 0;
+static SemaphoreHandle_t slotFreeSemaphore = NULL;
+
+// Compositor task, pinned to the core the game loop does not run on
+static TaskHandle_t presentTask = NULL;
+static SemaphoreHandle_t presentTaskSyncSemaphore = NULL;
+static bool presentTaskRunning = false;
+static volatile bool composing = false;
+
+// DMA capable staging buffers holding the dirty rectangles in panel pixel format
+static uint16_t *presentBuffers[PRESENT_BUFFER_COUNT];
+static int presentBufferIndex = 0;
+
+// Transfer sequence numbers: the last transfer reading each buffer, issued and completed so far
+static uint32_t bufferLastTransfer[PRESENT_BUFFER_COUNT];
+static uint32_t issuedTransfers = 0;
+static volatile uint32_t completedTransfers = 0;
+static SemaphoreHandle_t transferDoneSemaphore = NULL;
+
+// Game loop side stats
+static int64_t submitTimeTotal = 0;
+static int64_t submitWaitTotal = 0;
+static int submitFrameCount = 0;
+static int submitSkipCount = 0;
+static int submitOverlapCount = 0;
+
+// Compositor side stats
+static int64_t composeTimeTotal = 0;
+static int64_t composeWaitTotal = 0;
+static int64_t composeLatencyTotal = 0;
+static int64_t composeBytesTotal = 0;
+static int composeRectTotal = 0;
+static int composeFrameCount = 0;
+
+static inline void update_dirty_bit(int cell)
+{
+    int row = cell / PRESENT_CELLS;
+    uint32_t bit = 1u << (cell % PRESENT_CELLS);
+
+    if (cellSignatures[cell] != presentedSignatures[cell]) {
+        dirtyTiles[row] |= bit;
+    }
+    else {
+        dirtyTiles[row] &= ~bit;
+    }
+}
+
+static bool present_on_trans_done(void *user_ctx)
+{
+    BaseType_t needYield = pdFALSE;
+
+    completedTransfers++;
+    xSemaphoreGiveFromISR(transferDoneSemaphore, &needYield);
+
+    return needYield == pdTRUE;
+}
+
+// Block until the panel is done with every transfer up to the given sequence number
+static void wait_for_transfer(uint32_t sequence)
+{
+    while ((int32_t)(completedTransfers - sequence) < 0) {
+        xSemaphoreTake(transferDoneSemaphore, portMAX_DELAY);
+    }
+}
+
+static void compose_slot(const present_slot_t *slot);
+
+static void present_task(void *arg)
+{
+    // Keep LVGL off the panel for as long as bitsybox owns it, instead of locking every frame.
+    // Whatever it still has in flight drains first so it isn't counted as ours.
+    lvgl_port_lock(0);
+    vgc_lcd_wait_idle();
+    issuedTransfers = 0;
+    completedTransfers = 0;
+    vgc_lcd_set_trans_done_cb(present_on_trans_done, NULL);
+    xSemaphoreGive(presentTaskSyncSemaphore);
+
+    while (true) {
+        uint32_t tail = queueTail;
+        if (tail == __atomic_load_n(&queueHead, __ATOMIC_ACQUIRE)) {
+            if (!__atomic_load_n(&presentTaskRunning, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        composing = true;
+        compose_slot(&presentQueue[tail % PRESENT_QUEUE_LENGTH]);
+        composing = false;
+
+        __atomic_store_n(&queueTail, tail + 1, __ATOMIC_RELEASE);
+        xSemaphoreGive(slotFreeSemaphore);
+    }
+
+    // The panel may still be reading the last frame
+    wait_for_transfer(issuedTransfers);
+    vgc_lcd_set_trans_done_cb(NULL, NULL);
+    lvgl_port_unlock();
+
+    xSemaphoreGive(presentTaskSyncSemaphore);
+    vTaskDelete(NULL);
+}
+
+bool init_present(void)
+{
+    for (int i = 0; i < PRESENT_BUFFER_COUNT; i++) {
+        presentBuffers[i] = heap_caps_malloc(SCREEN_SIZE * SCREEN_SIZE * sizeof(uint16_t), MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if (presentBuffers[i] == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate memory for present buffer %d", i);
+            deinit_present();
+            return false;
+        }
+        bufferLastTransfer[i] = 0;
+    }
+
+    // Large enough for a full override frame
+    for (int i = 0; i < PRESENT_QUEUE_LENGTH; i++) {
+        presentQueue[i].pixels = heap_caps_malloc(SCREEN_SIZE * SCREEN_SIZE * sizeof(bitsy_color_t), MALLOC_CAP_SPIRAM);
+        if (presentQueue[i].pixels == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate memory for present queue slot %d", i);
+            deinit_present();
+            return false;
+        }
+    }
+    queueHead = 0;
+    queueTail = 0;
+
+    transferDoneSemaphore = xSemaphoreCreateBinary();
+    slotFreeSemaphore = xSemaphoreCreateBinary();
+    presentTaskSyncSemaphore = xSemaphoreCreateBinary();
+    if (transferDoneSemaphore == NULL || slotFreeSemaphore == NULL || presentTaskSyncSemaphore == NULL) {
+        ESP_LOGE(TAG, "Failed to create present semaphores");
+        deinit_present();
+        return false;
+    }
+
+    presentTaskRunning = true;
+    if (xTaskCreatePinnedToCore(present_task, "present", PRESENT_TASK_STACK_SIZE, NULL, PRESENT_TASK_PRIORITY, &presentTask, PRESENT_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create present task");
+        presentTaskRunning = false;
+        presentTask = NULL;
+        deinit_present();
+        return false;
+    }
+
+    // Wait until the compositor owns the panel
+    xSemaphoreTake(presentTaskSyncSemaphore, portMAX_DELAY);
+
+    // first frame always goes out in full
+    present_invalidate();
+
+    return true;
+}
+
+void deinit_present(void)
+{
+    if (presentTask != NULL) {
+        // The compositor finishes the queued frames before it stops
+        __atomic_store_n(&presentTaskRunning, false, __ATOMIC_RELEASE);
+        xTaskNotifyGive(presentTask);
+        xSemaphoreTake(presentTaskSyncSemaphore, portMAX_DELAY);
+        presentTask = NULL;
+    }
+
+    SemaphoreHandle_t *semaphores[] = {&transferDoneSemaphore, &slotFreeSemaphore, &presentTaskSyncSemaphore};
+    for (int i = 0; i < sizeof(semaphores) / sizeof(semaphores[0]); i++) {
+        if (*semaphores[i] != NULL) {
+            vSemaphoreDelete(*semaphores[i]);
+            *semaphores[i] = NULL;
+        }
+    }
+
+    for (int i = 0; i < PRESENT_QUEUE_LENGTH; i++) {
+        if (presentQueue[i].pixels != NULL) {
+            heap_caps_free(presentQueue[i].pixels);
+            presentQueue[i].pixels = NULL;
+        }
+    }
+
+    for (int i = 0; i < PRESENT_BUFFER_COUNT; i++) {
+        if (presentBuffers[i] != NULL) {
+            heap_caps_free(presentBuffers[i]);
+            presentBuffers[i] = NULL;
+        }
+    }
+}
+
+uint32_t present_new_signature(void)
+{
+    return nextSignature++;
+}
+
+void present_mark_dirty(int x, int y, int w, int h)
+{
+    int minCellX = x < 0 ? 0 : x / PRESENT_CELL_SIZE;
+    int minCellY = y < 0 ? 0 : y / PRESENT_CELL_SIZE;
+    int maxCellX = (x + w - 1) / PRESENT_CELL_SIZE;
+    int maxCellY = (y + h - 1) / PRESENT_CELL_SIZE;
+
+    if (maxCellX >= PRESENT_CELLS) {
+        maxCellX = PRESENT_CELLS - 1;
+    }
+    if (maxCellY >= PRESENT_CELLS) {
+        maxCellY = PRESENT_CELLS - 1;
+    }
+
+    // Pixel level changes can't be described by a signature, so give the cells
+    // a fresh one that can never match what the panel shows
+    for (int cellY = minCellY; cellY <= maxCellY; cellY++) {
+        for (int cellX = minCellX; cellX <= maxCellX; cellX++) {
+            cellSignatures[cellY * PRESENT_CELLS + cellX] = present_new_signature();
+            dirtyTiles[cellY] |= 1u << cellX;
+        }
+    }
+}
+
+void present_mark_tile(int tileX, int tileY, uint32_t signature)
+{
+    if (tileX < 0 || tileX >= PRESENT_CELLS || tileY < 0 || tileY >= PRESENT_CELLS) {
+        return;
+    }
+
+    // Mix so a sprite drawn over a tile ends up different from either one alone
+    int cell = tileY * PRESENT_CELLS + tileX;
+    cellSignatures[cell] = (cellSignatures[cell] ^ signature) * 0x01000193u;
+    update_dirty_bit(cell);
+}
+
+uint32_t present_get_cell(int cellX, int cellY)
+{
+    return cellSignatures[cellY * PRESENT_CELLS + cellX];
+}
+
+void present_set_cell(int cellX, int cellY, uint32_t signature)
+{
+    int cell = cellY * PRESENT_CELLS + cellX;
+    cellSignatures[cell] = signature;
+    update_dirty_bit(cell);
+}
+
+void present_mark_clear(uint32_t signature)
+{
+    for (int cell = 0; cell < PRESENT_CELLS * PRESENT_CELLS; cell++) {
+        cellSignatures[cell] = signature;
+        update_dirty_bit(cell);
+    }
+}
+
+void present_show_textbox(int x, int y)
+{
+    textbox.visible = true;
+    textbox.x = x * TEXTBOX_RENDER_SCALE;
+    textbox.y = y * TEXTBOX_RENDER_SCALE;
+    textbox.w = textboxWidth * TEXTBOX_RENDER_SCALE;
+    textbox.h = textboxHeight * TEXTBOX_RENDER_SCALE;
+}
+
+void present_hide_textbox(void)
+{
+    textbox.visible = false;
+}
+
+void present_textbox_changed(void)
+{
+    textboxContentChanged = true;
+}
+
+static uint32_t hash_textbox(void)
+{
+    typedef uint32_t __attribute__((__may_alias__)) word_t;
+
+    const uint8_t *bytes = (const uint8_t *)drawingBuffers[TEXTBOX_BUFFER_ID];
+    size_t size = textboxWidth * textboxHeight * TEXTBOX_RENDER_SCALE * TEXTBOX_RENDER_SCALE * sizeof(bitsy_pixel_t);
+    uint32_t hash = 0x811C9DC5u;
+
+    size_t i = 0;
+    for (; i + sizeof(word_t) <= size; i += sizeof(word_t)) {
+        hash = (hash ^ *(const word_t *)&bytes[i]) * 0x01000193u;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x01000193u;
+    }
+
+    return hash;
+}
+
+// Copy the part of the textbox that falls inside a screen rectangle into a buffer holding it
+void present_compose_textbox(bitsy_pixel_t *dst, int dstStride, int x, int y, int w, int h)
+{
+    if (!textbox.visible) {
+        return;
+    }
+
+    int left = textbox.x > x ? textbox.x : x;
+    int top = textbox.y > y ? textbox.y : y;
+    int right = textbox.x + textbox.w < x + w ? textbox.x + textbox.w : x + w;
+    int bottom = textbox.y + textbox.h < y + h ? textbox.y + textbox.h : y + h;
+    if (left >= right || top >= bottom) {
+        return;
+    }
+
+    const bitsy_pixel_t *src = drawingBuffers[TEXTBOX_BUFFER_ID];
+    for (int row = top; row < bottom; row++) {
+        const bitsy_pixel_t *srcRow = &src[((row - textbox.y) / TEXTBOX_RENDER_SCALE) * textboxWidth];
+        bitsy_pixel_t *dstRow = &dst[(row - y) * dstStride + (left - x)];
+        if (TEXTBOX_RENDER_SCALE == 1) {
+            blit_copy_row(dstRow, &srcRow[left - textbox.x], right - left);
+            continue;
+        }
+        for (int col = left; col < right; col++) {
+            *dstRow++ = srcRow[(col - textbox.x) / TEXTBOX_RENDER_SCALE];
+        }
+    }
+}
+
+// Cells covered by the textbox as shown or as presented need to go out again, without
+// touching the signatures of the screen buffer under it
+static void mark_textbox_cells(const present_textbox_t *area)
+{
+    if (!area->visible) {
+        return;
+    }
+
+    int minCellX = area->x < 0 ? 0 : area->x / PRESENT_CELL_SIZE;
+    int minCellY = area->y < 0 ? 0 : area->y / PRESENT_CELL_SIZE;
+    int maxCellX = (area->x + area->w - 1) / PRESENT_CELL_SIZE;
+    int maxCellY = (area->y + area->h - 1) / PRESENT_CELL_SIZE;
+    if (maxCellX >= PRESENT_CELLS) {
+        maxCellX = PRESENT_CELLS - 1;
+    }
+    if (maxCellY >= PRESENT_CELLS) {
+        maxCellY = PRESENT_CELLS - 1;
+    }
+
+    for (int cellY = minCellY; cellY <= maxCellY; cellY++) {
+        for (int cellX = minCellX; cellX <= maxCellX; cellX++) {
+            dirtyTiles[cellY] |= 1u << cellX;
+        }
+    }
+}
+
+static bool textbox_equal(const present_textbox_t *a, const present_textbox_t *b)
+{
+    if (!a->visible || !b->visible) {
+        return a->visible == b->visible;
+    }
+    return a->x == b->x && a->y == b->y && a->w == b->w && a->h == b->h && a->signature == b->signature;
+}
+
+void present_invalidate(void)
+{
+    forceFullPresent = true;
+}
+
+void present_set_override(const bitsy_color_t *frame)
+{
+    overrideFrame = frame;
+    present_invalidate();
+}
+
+// Merge dirty cells into rectangles: runs within a row, then rows repeating the same run.
+// Returns -1 when there are more rectangles than worth sending one by one.
+static int collect_dirty_rects(present_rect_t *rects)
+{
+    int rectCount = 0;
+
+    for (int row = 0; row < PRESENT_CELLS; row++) {
+        uint32_t mask = dirtyTiles[row];
+
+        while (mask != 0) {
+            int start = __builtin_ctz(mask);
+            int length = __builtin_ctz(~(mask >> start));
+            mask &= ~(((1u << length) - 1) << start);
+
+            // Extend the rectangle ending on the previous row if it has the same span
+            bool extended = false;
+            for (int i = 0; i < rectCount; i++) {
+                if (rects[i].x == start && rects[i].w == length && rects[i].y + rects[i].h == row) {
+                    rects[i].h++;
+                    extended = true;
+                    break;
+                }
+            }
+
+            if (!extended) {
+                if (rectCount == PRESENT_MAX_RECTS) {
+                    return -1;
+                }
+                rects[rectCount].x = start;
+                rects[rectCount].y = row;
+                rects[rectCount].w = length;
+                rects[rectCount].h = 1;
+                rectCount++;
+            }
+        }
+    }
+
+    return rectCount;
+}
+
+// Compositor side: resolve a submitted frame into a staging buffer and queue it to the panel
+static void compose_slot(const present_slot_t *slot)
+{
+    int64_t startTime = esp_timer_get_time();
+
+    // Swap to the buffer the panel read two frames ago, normally long done by now
+    presentBufferIndex = (presentBufferIndex + 1) % PRESENT_BUFFER_COUNT;
+    uint16_t *presentBuffer = presentBuffers[presentBufferIndex];
+    wait_for_transfer(bufferLastTransfer[presentBufferIndex]);
+
+    int64_t waitTime = esp_timer_get_time() - startTime;
+
+    // Rectangles are packed back to back in the staging buffer and sent one transfer each.
+    // Transfers are queued, so the last one overlaps with composing the next frame.
+    const bitsy_pixel_t *src = slot->pixels;
+    uint16_t *dst = presentBuffer;
+    for (int i = 0; i < slot->rectCount; i++) {
+        int x = slot->rects[i].x * PRESENT_CELL_SIZE;
+        int y = slot->rects[i].y * PRESENT_CELL_SIZE;
+        int w = slot->rects[i].w * PRESENT_CELL_SIZE;
+        int h = slot->rects[i].h * PRESENT_CELL_SIZE;
+
+        uint16_t *bitmap = dst;
+        if (slot->isOverride) {
+            memcpy(dst, slot->pixels, SCREEN_SIZE * SCREEN_SIZE * sizeof(uint16_t));
+            dst += SCREEN_SIZE * SCREEN_SIZE;
+        }
+        else {
+#if INDEXED_FRAMEBUFFER
+            // Palette indices are resolved to panel colors while streaming out
+            for (int p = 0; p < w * h; p++) {
+                *dst++ = slot->palette[*src++];
+            }
+#else
+            memcpy(dst, src, w * h * sizeof(uint16_t));
+            dst += w * h;
+            src += w * h;
+#endif
+        }
+
+        esp_err_t err = vgc_lcd_draw_bitmap(x, y, w, h, bitmap);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to draw frame (%s)", esp_err_to_name(err));
+        }
+        else {
+            issuedTransfers++;
+        }
+    }
+    bufferLastTransfer[presentBufferIndex] = issuedTransfers;
+
+    int64_t endTime = esp_timer_get_time();
+    composeTimeTotal += endTime - startTime;
+    composeWaitTotal += waitTime;
+    composeLatencyTotal += endTime - slot->submitTime;
+    composeBytesTotal += (dst - presentBuffer) * sizeof(uint16_t);
+    composeRectTotal += slot->rectCount;
+    composeFrameCount++;
+
+    if (composeFrameCount == PRESENT_STATS_INTERVAL) {
+        ESP_LOGI(TAG, "Compose (core %d): %" PRId64 " us/frame (%" PRId64 " us waiting for DMA), %" PRId64 " us submit to flush, %" PRId64 " bytes/frame, %d rects/frame",
+                 xPortGetCoreID(), composeTimeTotal / composeFrameCount, composeWaitTotal / composeFrameCount,
+                 composeLatencyTotal / composeFrameCount, composeBytesTotal / composeFrameCount, composeRectTotal / composeFrameCount);
+        composeTimeTotal = 0;
+        composeWaitTotal = 0;
+        composeLatencyTotal = 0;
+        composeBytesTotal = 0;
+        composeRectTotal = 0;
+        composeFrameCount = 0;
+    }
+}
+
+// Game loop side: snapshot the dirty rectangles into a free queue slot and hand it over
+void present_frame(void)
+{
+    present_rect_t rects[PRESENT_MAX_RECTS];
+    int rectCount;
+
+    if (textbox.visible && textboxContentChanged) {
+        textboxSignature = hash_textbox();
+        textboxContentChanged = false;
+    }
+    textbox.signature = textboxSignature;
+
+    if (forceFullPresent) {
+        rectCount = -1;
+    }
+    else if (overrideFrame != NULL) {
+        // The override owner invalidates whenever it has a new frame
+        rectCount = 0;
+    }
+    else {
+        // Moving, hiding or changing the textbox repaints both where it was and where it is
+        if (!textbox_equal(&textbox, &presentedTextbox)) {
+            mark_textbox_cells(&presentedTextbox);
+            mark_textbox_cells(&textbox);
+        }
+        rectCount = collect_dirty_rects(rects);
+    }
+
+    if (rectCount == 0) {
+        // nothing changed since the last present
+        submitSkipCount++;
+        return;
+    }
+
+    if (rectCount < 0) {
+        // One full screen transfer instead of many small ones
+        rects[0].x = 0;
+        rects[0].y = 0;
+        rects[0].w = PRESENT_CELLS;
+        rects[0].h = PRESENT_CELLS;
+        rectCount = 1;
+    }
+
+    int64_t startTime = esp_timer_get_time();
+
+    // Only blocks when the compositor is a whole queue behind
+    uint32_t head = queueHead;
+    while (head - __atomic_load_n(&queueTail, __ATOMIC_ACQUIRE) == PRESENT_QUEUE_LENGTH) {
+        xSemaphoreTake(slotFreeSemaphore, portMAX_DELAY);
+    }
+    present_slot_t *slot = &presentQueue[head % PRESENT_QUEUE_LENGTH];
+
+    int64_t waitTime = esp_timer_get_time() - startTime;
+
+    memcpy(slot->rects, rects, rectCount * sizeof(present_rect_t));
+    slot->rectCount = rectCount;
+    slot->isOverride = overrideFrame != NULL;
+
+    if (slot->isOverride) {
+        memcpy(slot->pixels, overrideFrame, SCREEN_SIZE * SCREEN_SIZE * sizeof(bitsy_color_t));
+    }
+    else {
+        bitsy_pixel_t *dst = slot->pixels;
+        for (int i = 0; i < rectCount; i++) {
+            int x = rects[i].x * PRESENT_CELL_SIZE;
+            int y = rects[i].y * PRESENT_CELL_SIZE;
+            int w = rects[i].w * PRESENT_CELL_SIZE;
+            int h = rects[i].h * PRESENT_CELL_SIZE;
+
+            // Full width rectangles are one block
+            if (w == SCREEN_SIZE) {
+                memcpy(dst, &drawingBuffers[SCREEN_BUFFER_ID][y * SCREEN_SIZE], w * h * sizeof(bitsy_pixel_t));
+            }
+            else {
+                for (int row = 0; row < h; row++) {
+                    memcpy(&dst[row * w], &drawingBuffers[SCREEN_BUFFER_ID][(y + row) * SCREEN_SIZE + x], w * sizeof(bitsy_pixel_t));
+                }
+            }
+
+            present_compose_textbox(dst, w, x, y, w, h);
+            dst += w * h;
+        }
+#if INDEXED_FRAMEBUFFER
+        memcpy(slot->palette, systemPalette, sizeof(slot->palette));
+#endif
+    }
+
+    // The compositor still working on an earlier frame means the two cores really overlap
+    if (composing || head != __atomic_load_n(&queueTail, __ATOMIC_ACQUIRE)) {
+        submitOverlapCount++;
+    }
+
+    slot->submitTime = esp_timer_get_time();
+    __atomic_store_n(&queueHead, head + 1, __ATOMIC_RELEASE);
+    xTaskNotifyGive(presentTask);
+
+    // The panel will show the screen buffer, unless it shows the override
+    if (overrideFrame == NULL) {
+        memcpy(presentedSignatures, cellSignatures, sizeof(presentedSignatures));
+        memset(dirtyTiles, 0, sizeof(dirtyTiles));
+        presentedTextbox = textbox;
+    }
+    forceFullPresent = false;
+
+    submitTimeTotal += esp_timer_get_time() - startTime;
+    submitWaitTotal += waitTime;
+    submitFrameCount++;
+
+    if (submitFrameCount == PRESENT_STATS_INTERVAL) {
+        ESP_LOGI(TAG, "Submit (core %d): %" PRId64 " us/frame (%" PRId64 " us waiting for a slot), %d of %d frames overlapped (%d skipped)",
+                 xPortGetCoreID(), submitTimeTotal / submitFrameCount, submitWaitTotal / submitFrameCount,
+                 submitOverlapCount, submitFrameCount, submitSkipCount);
+        submitTimeTotal = 0;
+        submitWaitTotal = 0;
+        submitFrameCount = 0;
+        submitSkipCount = 0;
+        submitOverlapCount = 0;
+    }
+}
@@ -0,0 +1,182 @@
+#include "bitsybox.h"
+
+static const char *TAG = "Room";
+
+// Room cells line up with the present cells, one tile each
+#define ROOM_CELL_SIZE (TILE_SIZE * RENDER_SCALE)
+
+// Tile ids of the current room at its current animation frame, row by row
+static int16_t roomTiles[ROOM_SIZE * ROOM_SIZE];
+static bitsy_pixel_t roomClearPixel;
+static bool roomTilesLoaded = false;
+
+// Pre-composed background of the current room and animation frame. Each cell remembers what it
+// was composed from, so an animation tick only recomposes the cells that actually changed.
+static bitsy_pixel_t *backgroundBuffer = NULL;
+static int16_t backgroundTiles[ROOM_SIZE * ROOM_SIZE];
+static uint32_t backgroundTileSignatures[ROOM_SIZE * ROOM_SIZE];
+static bitsy_pixel_t backgroundClearPixel;
+static bool backgroundValid = false;
+
+// Present signature given to each background cell, the screen cell holds the background
+// for as long as its present signature still matches
+static uint32_t backgroundCellSignatures[ROOM_SIZE * ROOM_SIZE];
+
+// Background cache stats
+static uint32_t cacheHitCount = 0;
+static uint32_t cacheMissCount = 0;
+static uint32_t cellComposeCount = 0;
+static uint32_t cellRestoreCount = 0;
+
+bool init_room(void)
+{
+    backgroundBuffer = heap_caps_malloc(SCREEN_SIZE * SCREEN_SIZE * sizeof(bitsy_pixel_t), MALLOC_CAP_SPIRAM);
+    if (backgroundBuffer == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate memory for room background");
+        return false;
+    }
+
+    roomTilesLoaded = false;
+    backgroundValid = false;
+
+    return true;
+}
+
+void deinit_room(void)
+{
+    if (backgroundBuffer != NULL) {
+        heap_caps_free(backgroundBuffer);
+        backgroundBuffer = NULL;
+    }
+    roomTilesLoaded = false;
+    backgroundValid = false;
+}
+
+void room_reset(void)
+{
+    roomTilesLoaded = false;
+    backgroundValid = false;
+}
+
+// Bring the cached background up to date, returns the number of cells recomposed
+static int compose_background(void)
+{
+    bool recomposeAll = !backgroundValid || backgroundClearPixel != roomClearPixel;
+    int composed = 0;
+
+    for (int cell = 0; cell < ROOM_SIZE * ROOM_SIZE; cell++) {
+        int tileId = roomTiles[cell];
+        bool hasTile = tile_atlas_contains(tileId);
+        uint32_t tileSignature = hasTile ? tile_signature(tileId) : 0;
+
+        if (!recomposeAll && backgroundTiles[cell] == tileId && backgroundTileSignatures[cell] == tileSignature) {
+            continue;
+        }
+
+        int x = (cell % ROOM_SIZE) * ROOM_CELL_SIZE;
+        int y = (cell / ROOM_SIZE) * ROOM_CELL_SIZE;
+        bitsy_pixel_t *dst = &backgroundBuffer[y * SCREEN_SIZE + x];
+
+        if (hasTile) {
+            blit_copy_rect(dst, SCREEN_SIZE, tile_atlas_pixels(tileId), TILE_SIZE, TILE_SIZE, TILE_SIZE, RENDER_SCALE);
+        }
+        else {
+            blit_fill_rect(dst, SCREEN_SIZE, roomClearPixel, ROOM_CELL_SIZE, ROOM_CELL_SIZE);
+        }
+
+        backgroundTiles[cell] = tileId;
+        backgroundTileSignatures[cell] = tileSignature;
+        backgroundCellSignatures[cell] = present_new_signature();
+        composed++;
+    }
+
+    backgroundClearPixel = roomClearPixel;
+    backgroundValid = true;
+
+    return composed;
+}
+
+void draw_room(void)
+{
+    // Can only draw the room on the screen buffer in tile mode
+    if (!roomTilesLoaded || curBufferId != 0 || curGraphicsMode != 1) {
+        return;
+    }
+
+    int composed = compose_background();
+    if (composed == 0) {
+        cacheHitCount++;
+    }
+    else {
+        cacheMissCount++;
+        cellComposeCount += composed;
+    }
+
+    // Every write to the screen changes the present signature of its cells, so only cells
+    // drawn over since the last restore (sprites, text, a clear) are copied back
+    for (int cellY = 0; cellY < ROOM_SIZE; cellY++) {
+        for (int cellX = 0; cellX < ROOM_SIZE; cellX++) {
+            int cell = cellY * ROOM_SIZE + cellX;
+            if (present_get_cell(cellX, cellY) == backgroundCellSignatures[cell]) {
+                continue;
+            }
+
+            int offset = cellY * ROOM_CELL_SIZE * SCREEN_SIZE + cellX * ROOM_CELL_SIZE;
+            blit_copy_rect_1x(&drawingBuffers[SCREEN_BUFFER_ID][offset], SCREEN_SIZE, &backgroundBuffer[offset], SCREEN_SIZE, ROOM_CELL_SIZE, ROOM_CELL_SIZE);
+            present_set_cell(cellX, cellY, backgroundCellSignatures[cell]);
+            cellRestoreCount++;
+        }
+    }
+}
+
+void log_room_stats(void)
+{
+    ESP_LOGI(TAG, "Background cache: %" PRIu32 " hits, %" PRIu32 " misses, %" PRIu32 " cells composed, %" PRIu32 " cells restored",
+             cacheHitCount, cacheMissCount, cellComposeCount, cellRestoreCount);
+}
+
+// bitsySetRoomTiles(tiles, clearPaletteIndex): tiles is a buffer or typed array of ROOM_SIZE * ROOM_SIZE
+// int16 tile ids (-1 for empty cells, which show the clear color) with animations already resolved.
+// Upload it when the room changes or an animation ticks, then draw the background every frame with
+// bitsyDrawRoom; the engine no longer needs to clear the screen first.
+duk_ret_t bitsy_set_room_tiles(duk_context *ctx)
+{
+    duk_size_t size = 0;
+    const int16_t *tiles = duk_get_buffer_data(ctx, 0, &size);
+    if (tiles == NULL || size < sizeof(roomTiles) || size % sizeof(int16_t) != 0 || (uintptr_t)tiles % sizeof(int16_t) != 0) {
+        return DUK_RET_TYPE_ERROR;
+    }
+
+    int clearIndex = duk_get_int_default(ctx, 1, 0);
+    if (clearIndex < 0 || clearIndex >= SYSTEM_PALETTE_MAX) {
+        return DUK_RET_RANGE_ERROR;
+    }
+
+    memcpy(roomTiles, tiles, sizeof(roomTiles));
+    roomClearPixel = BITSY_PIXEL(clearIndex);
+    roomTilesLoaded = true;
+
+    return 0;
+}
+
+duk_ret_t bitsy_draw_room(duk_context *ctx)
+{
+    drawCallCount++;
+    draw_room();
+    return 0;
+}
+
+// bitsyGetRoomCacheStats(): running totals since startup
+duk_ret_t bitsy_get_room_cache_stats(duk_context *ctx)
+{
+    duk_push_object(ctx);
+    duk_push_uint(ctx, cacheHitCount);
+    duk_put_prop_string(ctx, -2, "hits");
+    duk_push_uint(ctx, cacheMissCount);
+    duk_put_prop_string(ctx, -2, "misses");
+    duk_push_uint(ctx, cellComposeCount);
+    duk_put_prop_string(ctx, -2, "cellsComposed");
+    duk_push_uint(ctx, cellRestoreCount);
+    duk_put_prop_string(ctx, -2, "cellsRestored");
+    return 1;
+}
@@ -0,0 +1,72 @@
+#include "bitsybox.h"
+
+static const char *TAG = "TileAtlas";
+
+// Each tile starts on its own cache line of PSRAM
+#define TILE_ATLAS_ALIGNMENT 64
+
+bitsy_pixel_t *tileAtlas = NULL;
+
+// Tiles are handed out in order and only ever released all at once
+static int tileAtlasCount = 0;
+static int tileAtlasPeak = 0;
+
+bool init_tile_atlas(void)
+{
+    tileAtlas = heap_caps_aligned_alloc(TILE_ATLAS_ALIGNMENT, TILE_ATLAS_CAPACITY * TILE_PIXEL_COUNT * sizeof(bitsy_pixel_t), MALLOC_CAP_SPIRAM);
+    if (tileAtlas == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate memory for tile atlas");
+        return false;
+    }
+
+    tileAtlasCount = 0;
+    tileAtlasPeak = 0;
+
+    return true;
+}
+
+void deinit_tile_atlas(void)
+{
+    if (tileAtlas != NULL) {
+        heap_caps_free(tileAtlas);
+        tileAtlas = NULL;
+    }
+    tileAtlasCount = 0;
+}
+
+int tile_atlas_alloc(void)
+{
+    if (tileAtlasCount == TILE_ATLAS_CAPACITY) {
+        ESP_LOGE(TAG, "Tile atlas is full");
+        tile_atlas_log_usage();
+        return -1;
+    }
+
+    int tileId = TILE_ATLAS_FIRST_ID + tileAtlasCount;
+
+    tileAtlasCount++;
+    if (tileAtlasCount > tileAtlasPeak) {
+        tileAtlasPeak = tileAtlasCount;
+    }
+
+    return tileId;
+}
+
+void tile_atlas_reset(void)
+{
+    tileAtlasCount = 0;
+}
+
+bool tile_atlas_contains(int tileId)
+{
+    return tileId >= TILE_ATLAS_FIRST_ID && tileId < TILE_ATLAS_FIRST_ID + tileAtlasCount;
+}
+
+void tile_atlas_log_usage(void)
+{
+    const int tileSize = TILE_PIXEL_COUNT * sizeof(bitsy_pixel_t);
+
+    ESP_LOGI(TAG, "Tile atlas: %d of %d tiles used (%d of %d KB), peak %d",
+             tileAtlasCount, TILE_ATLAS_CAPACITY, tileAtlasCount * tileSize / 1024,
+             TILE_ATLAS_CAPACITY * tileSize / 1024, tileAtlasPeak);
+}
@@ -0,0 +1,401 @@
+#include "bitsybox.h"
+#include <math.h>
+
+static const char *TAG = "Transition";
+
+typedef enum
+{
+    TRANSITION_FADE_WHITE,
+    TRANSITION_FADE_BLACK,
+    TRANSITION_WAVE,
+    TRANSITION_TUNNEL,
+    TRANSITION_SLIDE_UP,
+    TRANSITION_SLIDE_DOWN,
+    TRANSITION_SLIDE_LEFT,
+    TRANSITION_SLIDE_RIGHT,
+} transition_effect_t;
+
+static const struct
+{
+    const char *name;
+    transition_effect_t effect;
+} transitionEffects[] = {
+    {"fade_w", TRANSITION_FADE_WHITE},
+    {"fade_b", TRANSITION_FADE_BLACK},
+    {"wave", TRANSITION_WAVE},
+    {"tunnel", TRANSITION_TUNNEL},
+    {"slide_u", TRANSITION_SLIDE_UP},
+    {"slide_d", TRANSITION_SLIDE_DOWN},
+    {"slide_l", TRANSITION_SLIDE_LEFT},
+    {"slide_r", TRANSITION_SLIDE_RIGHT},
+};
+
+// Screen contents at one end of the transition
+typedef struct
+{
+    bitsy_color_t *colors;
+#if INDEXED_FRAMEBUFFER
+    bitsy_pixel_t *pixels;
+    bitsy_color_t palette[SYSTEM_PALETTE_MAX];
+#endif
+} transition_image_t;
+
+static bool transitionActive = false;
+static bool endImagePending = false;
+static transition_effect_t curEffect;
+static int stepCount = 0;
+static int curStep = -1;
+static int64_t stepTime = 0;
+static int64_t transitionStartTime = 0;
+static int playerCenterX = SCREEN_SIZE / 2;
+static int playerCenterY = SCREEN_SIZE / 2;
+
+static transition_image_t startImage;
+static transition_image_t endImage;
+
+// Frame shown on the panel while the transition runs
+static bitsy_color_t *transitionFrame = NULL;
+
+static void free_transition_buffers(void)
+{
+    transition_image_t *images[] = {&startImage, &endImage};
+    for (int i = 0; i < 2; i++) {
+        heap_caps_free(images[i]->colors);
+        images[i]->colors = NULL;
+#if INDEXED_FRAMEBUFFER
+        heap_caps_free(images[i]->pixels);
+        images[i]->pixels = NULL;
+#endif
+    }
+    heap_caps_free(transitionFrame);
+    transitionFrame = NULL;
+}
+
+static bool alloc_transition_buffers(void)
+{
+    const size_t colorSize = SCREEN_SIZE * SCREEN_SIZE * sizeof(bitsy_color_t);
+
+    transition_image_t *images[] = {&startImage, &endImage};
+    for (int i = 0; i < 2; i++) {
+        images[i]->colors = heap_caps_malloc(colorSize, MALLOC_CAP_SPIRAM);
+        if (images[i]->colors == NULL) {
+            free_transition_buffers();
+            return false;
+        }
+#if INDEXED_FRAMEBUFFER
+        images[i]->pixels = heap_caps_malloc(SCREEN_SIZE * SCREEN_SIZE * sizeof(bitsy_pixel_t), MALLOC_CAP_SPIRAM);
+        if (images[i]->pixels == NULL) {
+            free_transition_buffers();
+            return false;
+        }
+#endif
+    }
+
+    transitionFrame = heap_caps_malloc(colorSize, MALLOC_CAP_SPIRAM);
+    if (transitionFrame == NULL) {
+        free_transition_buffers();
+        return false;
+    }
+
+    return true;
+}
+
+static void capture_image(transition_image_t *image)
+{
+    // What the panel would show: the screen buffer with the textbox over it
+#if INDEXED_FRAMEBUFFER
+    bitsy_pixel_t *pixels = image->pixels;
+#else
+    bitsy_pixel_t *pixels = image->colors;
+#endif
+    memcpy(pixels, drawingBuffers[SCREEN_BUFFER_ID], SCREEN_SIZE * SCREEN_SIZE * sizeof(bitsy_pixel_t));
+    present_compose_textbox(pixels, SCREEN_SIZE, 0, 0, SCREEN_SIZE, SCREEN_SIZE);
+
+#if INDEXED_FRAMEBUFFER
+    for (int i = 0; i < SCREEN_SIZE * SCREEN_SIZE; i++) {
+        image->colors[i] = BITSY_PIXEL_COLOR(pixels[i]);
+    }
+    memcpy(image->palette, systemPalette, sizeof(image->palette));
+#endif
+}
+
+// Blend two panel colors, amount goes from 0 (from) to 256 (to)
+static bitsy_color_t lerp_color(bitsy_color_t from, bitsy_color_t to, int amount)
+{
+    uint16_t a = (from >> 8) | (from << 8);
+    uint16_t b = (to >> 8) | (to << 8);
+
+    int red = ((a >> 11) * (256 - amount) + (b >> 11) * amount) >> 8;
+    int green = (((a >> 5) & 0x3F) * (256 - amount) + ((b >> 5) & 0x3F) * amount) >> 8;
+    int blue = ((a & 0x1F) * (256 - amount) + (b & 0x1F) * amount) >> 8;
+
+    uint16_t color = (red << 11) | (green << 5) | blue;
+    return (color >> 8) | (color << 8);
+}
+
+static void fill_span(bitsy_color_t *dst, bitsy_color_t color, int count)
+{
+    for (int i = 0; i < count; i++) {
+        dst[i] = color;
+    }
+}
+
+#if INDEXED_FRAMEBUFFER
+// Fades only touch the palette: fade the start palette out, then the end palette in
+static void render_fade(int delta, bitsy_color_t target)
+{
+    const transition_image_t *image = delta < 128 ? &startImage : &endImage;
+    int amount = delta < 128 ? delta * 2 : (256 - delta) * 2;
+
+    bitsy_color_t lut[SYSTEM_PALETTE_MAX];
+    for (int i = 0; i < SYSTEM_PALETTE_MAX; i++) {
+        lut[i] = lerp_color(image->palette[i], target, amount);
+    }
+
+    for (int i = 0; i < SCREEN_SIZE * SCREEN_SIZE; i++) {
+        transitionFrame[i] = lut[image->pixels[i]];
+    }
+}
+#endif
+
+// Rows are shifted sideways on a sine wave, swapping images half way
+static void render_wave(int delta)
+{
+    const bitsy_color_t *image = delta < 128 ? startImage.colors : endImage.colors;
+    float waveDelta = (delta < 128 ? delta * 2 : (256 - delta) * 2) / 256.0f;
+    float size = 2 + (14 * waveDelta);
+
+    for (int y = 0; y < SCREEN_SIZE; y++) {
+        float offset = y + (waveDelta * waveDelta * 0.2f * SCREEN_SIZE);
+        int shift = (int)floorf(sinf(offset / 4) * size);
+        shift = ((shift % SCREEN_SIZE) + SCREEN_SIZE) % SCREEN_SIZE;
+
+        const bitsy_color_t *src = &image[y * SCREEN_SIZE];
+        bitsy_color_t *dst = &transitionFrame[y * SCREEN_SIZE];
+        memcpy(dst, src + shift, (SCREEN_SIZE - shift) * sizeof(bitsy_color_t));
+        memcpy(dst + SCREEN_SIZE - shift, src, shift * sizeof(bitsy_color_t));
+    }
+}
+
+// A circle around the player closes on the start image and opens on the end image
+static void render_tunnel(int delta)
+{
+    const bitsy_color_t black = bitsy_color_make(0, 0, 0);
+    const bitsy_color_t *image;
+    float radiusDelta;
+
+    if (delta <= 102) {
+        image = startImage.colors;
+        radiusDelta = 1.0f - (delta / 102.0f);
+    }
+    else if (delta <= 154) {
+        fill_span(transitionFrame, black, SCREEN_SIZE * SCREEN_SIZE);
+        return;
+    }
+    else {
+        image = endImage.colors;
+        radiusDelta = (delta - 154) / 102.0f;
+    }
+
+    // Far enough to uncover the corner farthest from the player
+    float farX = playerCenterX > SCREEN_SIZE / 2 ? playerCenterX : SCREEN_SIZE - playerCenterX;
+    float farY = playerCenterY > SCREEN_SIZE / 2 ? playerCenterY : SCREEN_SIZE - playerCenterY;
+    float radius = radiusDelta * sqrtf(farX * farX + farY * farY);
+
+    // Each row is black, one span of the image, black
+    for (int y = 0; y < SCREEN_SIZE; y++) {
+        bitsy_color_t *dst = &transitionFrame[y * SCREEN_SIZE];
+        float dy = y - playerCenterY;
+
+        if (dy * dy > radius * radius) {
+            fill_span(dst, black, SCREEN_SIZE);
+            continue;
+        }
+
+        int dx = (int)sqrtf(radius * radius - dy * dy);
+        int x0 = playerCenterX - dx < 0 ? 0 : playerCenterX - dx;
+        int x1 = playerCenterX + dx + 1 > SCREEN_SIZE ? SCREEN_SIZE : playerCenterX + dx + 1;
+
+        fill_span(dst, black, x0);
+        memcpy(dst + x0, &image[y * SCREEN_SIZE + x0], (x1 - x0) * sizeof(bitsy_color_t));
+        fill_span(dst + x1, black, SCREEN_SIZE - x1);
+    }
+}
+
+// The end image pushes the start image out: whole rows for vertical slides, two spans per row otherwise
+static void render_slide(int delta)
+{
+    int offset = (delta * SCREEN_SIZE) >> 8;
+    const size_t rowSize = SCREEN_SIZE * sizeof(bitsy_color_t);
+
+    for (int y = 0; y < SCREEN_SIZE; y++) {
+        bitsy_color_t *dst = &transitionFrame[y * SCREEN_SIZE];
+        const bitsy_color_t *startRow = &startImage.colors[y * SCREEN_SIZE];
+        const bitsy_color_t *endRow = &endImage.colors[y * SCREEN_SIZE];
+
+        switch (curEffect) {
+        case TRANSITION_SLIDE_UP: {
+            int srcY = y - offset;
+            memcpy(dst, srcY >= 0 ? &startImage.colors[srcY * SCREEN_SIZE] : &endImage.colors[(srcY + SCREEN_SIZE) * SCREEN_SIZE], rowSize);
+            break;
+        }
+        case TRANSITION_SLIDE_DOWN: {
+            int srcY = y + offset;
+            memcpy(dst, srcY < SCREEN_SIZE ? &startImage.colors[srcY * SCREEN_SIZE] : &endImage.colors[(srcY - SCREEN_SIZE) * SCREEN_SIZE], rowSize);
+            break;
+        }
+        case TRANSITION_SLIDE_LEFT:
+            memcpy(dst, endRow + SCREEN_SIZE - offset, offset * sizeof(bitsy_color_t));
+            memcpy(dst + offset, startRow, (SCREEN_SIZE - offset) * sizeof(bitsy_color_t));
+            break;
+        default:
+            memcpy(dst, startRow + offset, (SCREEN_SIZE - offset) * sizeof(bitsy_color_t));
+            memcpy(dst + SCREEN_SIZE - offset, endRow, offset * sizeof(bitsy_color_t));
+            break;
+        }
+    }
+}
+
+static void render_step(int step)
+{
+    // 0 at the first step, 256 at the last
+    int delta = stepCount > 1 ? (step * 256) / (stepCount - 1) : 256;
+
+    switch (curEffect) {
+#if INDEXED_FRAMEBUFFER
+    case TRANSITION_FADE_WHITE:
+        render_fade(delta, bitsy_color_make(255, 255, 255));
+        break;
+    case TRANSITION_FADE_BLACK:
+        render_fade(delta, bitsy_color_make(0, 0, 0));
+        break;
+#endif
+    case TRANSITION_WAVE:
+        render_wave(delta);
+        break;
+    case TRANSITION_TUNNEL:
+        render_tunnel(delta);
+        break;
+    default:
+        render_slide(delta);
+        break;
+    }
+}
+
+bool update_transition(duk_context *ctx)
+{
+    if (!transitionActive) {
+        return false;
+    }
+
+    // The engine drew the end room during the tick that began the transition
+    if (endImagePending) {
+        capture_image(&endImage);
+        endImagePending = false;
+        transitionStartTime = gameClock;
+        curStep = -1;
+        present_set_override(transitionFrame);
+    }
+
+    int step = (int)((gameClock - transitionStartTime) / stepTime);
+
+    if (step >= stepCount) {
+        // Back to the screen buffer, which still holds the end room
+        present_set_override(NULL);
+        free_transition_buffers();
+        transitionActive = false;
+
+        if (duk_push_bitsy_callback(ctx, BITSY_CALLBACK_TRANSITION_DONE) && duk_pcall(ctx, 0) != 0) {
+            printf("Transition Complete Error: %s\n", duk_safe_to_string(ctx, -1));
+        }
+        duk_pop(ctx);
+
+        return true;
+    }
+
+    if (step != curStep) {
+        render_step(step);
+        curStep = step;
+        present_invalidate();
+    }
+
+    return false;
+}
+
+void deinit_transition(void)
+{
+    if (transitionActive) {
+        present_set_override(NULL);
+        transitionActive = false;
+    }
+    free_transition_buffers();
+}
+
+static int clamp_to_screen(int value)
+{
+    return value < 0 ? 0 : value >= SCREEN_SIZE ? SCREEN_SIZE - 1 : value;
+}
+
+// bitsyBeginTransition(effect, steps, stepTimeMs, playerCenterX, playerCenterY, onDone): runs the
+// effect natively between the current screen and the next frame drawn. The player center is in
+// screen pixels (0..SCREEN_SIZE-1, clamped), it's where the tunnel closes in on. Returns false if
+// the effect is left to the engine.
+duk_ret_t bitsy_begin_transition(duk_context *ctx)
+{
+    const char *effectName = duk_safe_to_string(ctx, 0);
+    int steps = duk_get_int(ctx, 1);
+    int stepTimeMs = duk_get_int(ctx, 2);
+
+    int effectIndex = -1;
+    for (int i = 0; i < sizeof(transitionEffects) / sizeof(transitionEffects[0]); i++) {
+        if (strcmp(effectName, transitionEffects[i].name) == 0) {
+            effectIndex = i;
+            break;
+        }
+    }
+
+#if !INDEXED_FRAMEBUFFER
+    // Palette fades need the palette indices, leave them to the engine
+    if (effectIndex >= 0 && transitionEffects[effectIndex].effect <= TRANSITION_FADE_BLACK) {
+        effectIndex = -1;
+    }
+#endif
+
+    if (effectIndex < 0 || steps <= 0 || transitionActive || !alloc_transition_buffers()) {
+        duk_push_false(ctx);
+        return 1;
+    }
+
+    curEffect = transitionEffects[effectIndex].effect;
+    stepCount = steps;
+    stepTime = (stepTimeMs > 0 ? stepTimeMs : 1) * 1000LL;
+    playerCenterX = clamp_to_screen(duk_get_int_default(ctx, 3, SCREEN_SIZE / 2));
+    playerCenterY = clamp_to_screen(duk_get_int_default(ctx, 4, SCREEN_SIZE / 2));
+
+    // Store the completion callback, called once the last step was shown
+    duk_push_heap_stash(ctx);
+    if (duk_is_function(ctx, 5)) {
+        duk_dup(ctx, 5);
+    }
+    else {
+        duk_push_undefined(ctx);
+    }
+    duk_put_prop_string(ctx, -2, BITSY_CALLBACK_TRANSITION_DONE);
+    duk_pop(ctx);
+
+    // The screen still shows the start room, the end room is drawn next
+    capture_image(&startImage);
+    endImagePending = true;
+    transitionActive = true;
+
+    ESP_LOGI(TAG, "Begin %s transition, %d steps", effectName, stepCount);
+
+    duk_push_true(ctx);
+    return 1;
+}
+
+duk_ret_t bitsy_is_transition_active(duk_context *ctx)
+{
+    duk_push_boolean(ctx, transitionActive);
+    return 1;
+}
@@ -0,0 +1,191 @@
+#include "bitsybox.h"
+#include <string.h>
+#include <stdio.h>
+#include "esp_timer.h"
+#include "assets.h"
+
+static const char *TAG = "WorldCache";
+
+// The parsed world is kept on the FAT partition as CBOR, one file per game named after a hash of
+// the game's asset path. The header holds the hash of the game text, so an edited game never
+// picks up a stale world and its next save replaces the old one. The shape of the world comes
+// from the engine's parseWorld, so the header also holds a hash of the engine bytecode: flashing
+// a new engine into the assets partition invalidates every cache without a firmware change.
+#define WORLD_CACHE_MAGIC "BWC2"
+#define WORLD_CACHE_DIR "/spiflash"
+
+typedef struct
+{
+    char magic[4];
+    uint32_t engineHash;
+    uint32_t gameHash;
+    uint32_t length;
+} world_cache_header_t;
+
+static uint32_t engineHash = 0;
+static bool engineHashValid = false;
+static uint32_t gameHash = 0;
+static uint32_t gamePathHash = 0;
+static bool gameHashValid = false;
+static bool worldCacheHit = false;
+
+#define WORLD_CACHE_HASH_SEED 0x811C9DC5u
+
+// FNV-1a, fast enough to run over the whole game text on every boot
+static uint32_t hash_bytes(const void *data, size_t length)
+{
+    const uint8_t *bytes = data;
+    uint32_t hash = WORLD_CACHE_HASH_SEED;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 0x01000193u;
+    }
+    return hash;
+}
+
+void world_cache_set_game(const char *path, const char *data, size_t length)
+{
+    gameHash = hash_bytes(data, length);
+    gamePathHash = hash_bytes(path, strlen(path));
+    gameHashValid = true;
+    worldCacheHit = false;
+}
+
+void world_cache_set_engine(const char *const *paths, int count)
+{
+    engineHash = WORLD_CACHE_HASH_SEED;
+    engineHashValid = true;
+    for (int i = 0; i < count; i++) {
+        if (!vgc_assets_hash(paths[i], &engineHash)) {
+            engineHashValid = false;
+        }
+    }
+}
+
+bool world_cache_was_hit(void)
+{
+    return worldCacheHit;
+}
+
+static void get_cache_path(char *path, size_t size)
+{
+    // Hashed so any asset path fits an 8.3 name
+    snprintf(path, size, WORLD_CACHE_DIR "/%08" PRIx32 ".wc", gamePathHash);
+}
+
+static duk_ret_t decode_world(duk_context *ctx, void *udata)
+{
+    duk_cbor_decode(ctx, -1, 0);
+    return 1;
+}
+
+// bitsyLoadWorldCache(): the world saved for this exact game text, or null on a cold boot.
+// The engine calls it instead of parseWorld and falls back to parsing when it gets null.
+duk_ret_t bitsy_load_world_cache(duk_context *ctx)
+{
+    int64_t startTime = esp_timer_get_time();
+
+    if (!gameHashValid || !engineHashValid) {
+        duk_push_null(ctx);
+        return 1;
+    }
+
+    char path[32];
+    get_cache_path(path, sizeof(path));
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        ESP_LOGI(TAG, "No cached world for game %08" PRIx32, gameHash);
+        duk_push_null(ctx);
+        return 1;
+    }
+
+    // A bad or stale file would fail the same way on every boot, so it is removed and the world parsed
+    long fileSize = -1;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        fileSize = ftell(f);
+        fseek(f, 0, SEEK_SET);
+    }
+
+    world_cache_header_t header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, WORLD_CACHE_MAGIC, 4) != 0 ||
+        header.engineHash != engineHash || header.gameHash != gameHash ||
+        fileSize != (long)(sizeof(header) + header.length)) {
+        ESP_LOGW(TAG, "Removing stale or invalid world cache %s", path);
+        fclose(f);
+        remove(path);
+        duk_push_null(ctx);
+        return 1;
+    }
+
+    // Read straight into the buffer CBOR is decoded from
+    void *buf = duk_push_fixed_buffer(ctx, header.length);
+    size_t readLength = fread(buf, 1, header.length, f);
+    fclose(f);
+    if (readLength != header.length) {
+        ESP_LOGW(TAG, "Removing truncated world cache %s", path);
+        duk_pop(ctx);
+        remove(path);
+        duk_push_null(ctx);
+        return 1;
+    }
+
+    // Malformed CBOR throws, keep that out of the engine's load path
+    if (duk_safe_call(ctx, decode_world, NULL, 1, 1) != DUK_EXEC_SUCCESS) {
+        ESP_LOGW(TAG, "Removing corrupt world cache %s: %s", path, duk_safe_to_string(ctx, -1));
+        duk_pop(ctx);
+        remove(path);
+        duk_push_null(ctx);
+        return 1;
+    }
+    worldCacheHit = true;
+
+    ESP_LOGI(TAG, "Restored world from %s (%" PRIu32 " bytes) in %" PRId64 " us", path, header.length, esp_timer_get_time() - startTime);
+
+    return 1;
+}
+
+// bitsySaveWorldCache(world): stores the parsed world for later boots, returns false if it
+// couldn't be written. Only plain data survives CBOR: no functions, no prototypes.
+duk_ret_t bitsy_save_world_cache(duk_context *ctx)
+{
+    int64_t startTime = esp_timer_get_time();
+
+    if (!gameHashValid || !engineHashValid || !duk_is_object(ctx, 0)) {
+        duk_push_false(ctx);
+        return 1;
+    }
+
+    char path[32];
+    get_cache_path(path, sizeof(path));
+
+    duk_dup(ctx, 0);
+    duk_cbor_encode(ctx, -1, 0);
+    duk_size_t length = 0;
+    const void *data = duk_get_buffer_data(ctx, -1, &length);
+
+    world_cache_header_t header = {
+        .magic = WORLD_CACHE_MAGIC,
+        .engineHash = engineHash,
+        .gameHash = gameHash,
+        .length = length,
+    };
+
+    FILE *f = fopen(path, "wb");
+    bool success = f != NULL && fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(data, 1, length, f) == length;
+    if (f != NULL && fclose(f) != 0) {
+        success = false;
+    }
+    duk_pop(ctx);
+
+    if (!success) {
+        ESP_LOGE(TAG, "Failed to write world cache %s", path);
+        remove(path);
+        duk_push_false(ctx);
+        return 1;
+    }
+
+    ESP_LOGI(TAG, "Saved world to %s (%d bytes) in %" PRId64 " us", path, (int)length, esp_timer_get_time() - startTime);
+
+    duk_push_true(ctx);
+    return 1;
+}
@@ -8,12 +8,24 @@
 #include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_vendor.h"
 #include "esp_lcd_panel_ops.h"
+#include "esp_lcd_panel_commands.h"
 #include "esp_lvgl_port.h"
 #include "esp_lcd_st7735.h"
+#include "esp_timer.h"
 #include "lvgl.h"
 
 static const char *TAG = "LCD";
 
+/* Transport used outside of the benchmark */
+static const vgc_lcd_profile_t vgc_lcd_default_profile = {
+    .pclk_hz = VGC_LCD_PIXEL_CLK_HZ,
+    .trans_queue_depth = VGC_LCD_TRANS_QUEUE_DEPTH,
+    .transfer_lines = VGC_LCD_TRANSFER_LINES,
+};
+
+/* Benchmark settings */
+#define VGC_LCD_BENCHMARK_FRAMES (30)
+
 /* LCD IO and panel */
 static esp_lcd_panel_io_handle_t vgc_lcd_io_handle = NULL;
 static esp_lcd_panel_handle_t vgc_lcd_panel_handle = NULL;
@@ -21,6 +33,28 @@ static esp_lcd_panel_handle_t vgc_lcd_panel_handle = NULL;
 /* LVGL display and touch */
 static lv_display_t *vgc_display = NULL;
 
+/* Color transfer done hook */
+static vgc_lcd_trans_done_cb_t vgc_lcd_trans_done_cb = NULL;
+static void *vgc_lcd_trans_done_ctx = NULL;
+
+static bool vgc_lcd_on_color_trans_done(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+{
+    bool need_yield = false;
+
+    // LVGL shares the panel IO, so keep telling it when its flush is done
+    if (vgc_display)
+    {
+        lv_display_flush_ready(vgc_display);
+    }
+
+    if (vgc_lcd_trans_done_cb)
+    {
+        need_yield = vgc_lcd_trans_done_cb(vgc_lcd_trans_done_ctx);
+    }
+
+    return need_yield;
+}
+
 esp_err_t vgc_lcd_clear(){
     // fill screen with black
     uint16_t *black_bitmap = heap_caps_malloc(VGC_LCD_H_RES * VGC_LCD_V_RES * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
@@ -30,17 +64,10 @@ esp_err_t vgc_lcd_clear(){
     return result;
 }
 
-esp_err_t vgc_lcd_init()
+static esp_err_t vgc_lcd_setup(const vgc_lcd_profile_t *profile)
 {
     esp_err_t ret = ESP_OK;
 
-    /* LCD backlight */
-    gpio_config_t bk_gpio_config = {
-        .mode = GPIO_MODE_OUTPUT,
-        .pin_bit_mask = 1ULL << VGC_LCD_GPIO_BL};
-    ESP_ERROR_CHECK(gpio_config(&bk_gpio_config));
-
-    /* LCD initialization */
     ESP_LOGD(TAG, "Initialize SPI bus");
     const spi_bus_config_t buscfg = {
         .sclk_io_num = VGC_LCD_GPIO_SCLK,
@@ -48,7 +75,8 @@ esp_err_t vgc_lcd_init()
         .miso_io_num = GPIO_NUM_NC,
         .quadwp_io_num = GPIO_NUM_NC,
         .quadhd_io_num = GPIO_NUM_NC,
-        .max_transfer_sz = VGC_LCD_H_RES * VGC_LCD_DRAW_BUFF_HEIGHT * sizeof(uint16_t),
+        // Color data longer than this is split into a chain of transactions
+        .max_transfer_sz = VGC_LCD_H_RES * profile->transfer_lines * sizeof(uint16_t),
     };
     ESP_RETURN_ON_ERROR(spi_bus_initialize(VGC_LCD_SPI_NUM, &buscfg, SPI_DMA_CH_AUTO), TAG, "SPI init failed");
 
@@ -56,11 +84,12 @@ esp_err_t vgc_lcd_init()
     const esp_lcd_panel_io_spi_config_t io_config = {
         .dc_gpio_num = VGC_LCD_GPIO_DC,
         .cs_gpio_num = VGC_LCD_GPIO_CS,
-        .pclk_hz = VGC_LCD_PIXEL_CLK_HZ,
+        .pclk_hz = profile->pclk_hz,
         .lcd_cmd_bits = VGC_LCD_CMD_BITS,
         .lcd_param_bits = VGC_LCD_PARAM_BITS,
         .spi_mode = 0,
-        .trans_queue_depth = 10,
+        .trans_queue_depth = profile->trans_queue_depth,
+        .on_color_trans_done = vgc_lcd_on_color_trans_done,
     };
     ESP_GOTO_ON_ERROR(esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)VGC_LCD_SPI_NUM, &io_config, &vgc_lcd_io_handle), err, TAG, "New panel IO failed");
 
@@ -78,10 +107,6 @@ esp_err_t vgc_lcd_init()
     esp_lcd_panel_set_gap(vgc_lcd_panel_handle, 2, 3);
     esp_lcd_panel_invert_color(vgc_lcd_panel_handle, false);
     esp_lcd_panel_disp_on_off(vgc_lcd_panel_handle, true);
-    vgc_lcd_clear();
-
-    /* LCD backlight on */
-    ESP_ERROR_CHECK(gpio_set_level(VGC_LCD_GPIO_BL, VGC_LCD_BL_ON_LEVEL));
 
     return ret;
 
@@ -89,22 +114,51 @@ err:
     if (vgc_lcd_panel_handle)
     {
         esp_lcd_panel_del(vgc_lcd_panel_handle);
+        vgc_lcd_panel_handle = NULL;
     }
     if (vgc_lcd_io_handle)
     {
         esp_lcd_panel_io_del(vgc_lcd_io_handle);
+        vgc_lcd_io_handle = NULL;
     }
     spi_bus_free(VGC_LCD_SPI_NUM);
     return ret;
 }
 
+static esp_err_t vgc_lcd_teardown()
+{
+    ESP_RETURN_ON_ERROR(esp_lcd_panel_del(vgc_lcd_panel_handle), TAG, "Delete panel failed");
+    vgc_lcd_panel_handle = NULL;
+    ESP_RETURN_ON_ERROR(esp_lcd_panel_io_del(vgc_lcd_io_handle), TAG, "Delete panel IO failed");
+    vgc_lcd_io_handle = NULL;
+    return spi_bus_free(VGC_LCD_SPI_NUM);
+}
+
+esp_err_t vgc_lcd_init()
+{
+    /* LCD backlight */
+    gpio_config_t bk_gpio_config = {
+        .mode = GPIO_MODE_OUTPUT,
+        .pin_bit_mask = 1ULL << VGC_LCD_GPIO_BL};
+    ESP_ERROR_CHECK(gpio_config(&bk_gpio_config));
+
+    /* LCD initialization */
+    ESP_RETURN_ON_ERROR(vgc_lcd_setup(&vgc_lcd_default_profile), TAG, "LCD setup failed");
+    vgc_lcd_clear();
+
+    /* LCD backlight on */
+    ESP_ERROR_CHECK(gpio_set_level(VGC_LCD_GPIO_BL, VGC_LCD_BL_ON_LEVEL));
+
+    return ESP_OK;
+}
+
 esp_err_t vgc_lvgl_init()
 {
     /* Initialize LVGL */
     const lvgl_port_cfg_t lvgl_cfg = {
         .task_priority = 4,       /* LVGL task priority */
         .task_stack = 4096,       /* LVGL task stack size */
-        .task_affinity = -1,      /* LVGL task pinned to core (-1 is no affinity) */
+        .task_affinity = 1,       /* LVGL task pinned to core (-1 is no affinity), next to the bitsybox compositor */
         .task_max_sleep_ms = 500, /* Maximum sleep in LVGL task */
         .timer_period_ms = 5      /* LVGL timer tick period in ms */
     };
@@ -132,6 +186,12 @@ esp_err_t vgc_lvgl_init()
         }};
     vgc_display = lvgl_port_add_disp(&disp_cfg);
 
+    /* The port registers its own transfer done callback, put ours back in front of it */
+    const esp_lcd_panel_io_callbacks_t cbs = {
+        .on_color_trans_done = vgc_lcd_on_color_trans_done,
+    };
+    ESP_RETURN_ON_ERROR(esp_lcd_panel_io_register_event_callbacks(vgc_lcd_io_handle, &cbs, NULL), TAG, "Register IO callbacks failed");
+
     return ESP_OK;
 }
 
@@ -144,19 +204,115 @@ esp_err_t vgc_lcd_deinit()
 
     /* Deinitialize LCD */
     ESP_ERROR_CHECK(esp_lcd_panel_disp_on_off(vgc_lcd_panel_handle, false));
-    ESP_ERROR_CHECK(esp_lcd_panel_del(vgc_lcd_panel_handle));
-    ESP_ERROR_CHECK(esp_lcd_panel_io_del(vgc_lcd_io_handle));
-    ESP_ERROR_CHECK(spi_bus_free(VGC_LCD_SPI_NUM));
+    ESP_ERROR_CHECK(vgc_lcd_teardown());
 
     return ret;
 }
 
 esp_err_t vgc_lcd_draw_bitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t *bitmap)
 {
-    return esp_lcd_panel_draw_bitmap(vgc_lcd_panel_handle, x, y, w, h, bitmap);
+    return esp_lcd_panel_draw_bitmap(vgc_lcd_panel_handle, x, y, x + w, y + h, bitmap);
+}
+
+esp_err_t vgc_lcd_wait_idle()
+{
+    // Parameter transfers are polled and wait for all queued color transfers first
+    return esp_lcd_panel_io_tx_param(vgc_lcd_io_handle, LCD_CMD_NOP, NULL, 0);
+}
+
+void vgc_lcd_set_trans_done_cb(vgc_lcd_trans_done_cb_t cb, void *user_ctx)
+{
+    vgc_lcd_trans_done_ctx = user_ctx;
+    vgc_lcd_trans_done_cb = cb;
+}
+
+esp_err_t vgc_lcd_benchmark()
+{
+    // Every profile re-creates the bus and panel IO, which LVGL would still be holding on to
+    ESP_RETURN_ON_FALSE(vgc_display == NULL, ESP_ERR_INVALID_STATE, TAG, "Benchmark must run before vgc_lvgl_init");
+
+    const uint32_t clocks[] = {10 * 1000 * 1000, 20 * 1000 * 1000, 80 * 1000 * 1000 / 3, 40 * 1000 * 1000};
+    const uint16_t lines[] = {8, 16, 32, 64, VGC_LCD_V_RES};
+    const size_t depths[] = {1, 2, 4, 10};
+
+    const size_t frame_size = VGC_LCD_H_RES * VGC_LCD_V_RES * sizeof(uint16_t);
+    uint16_t *frame = heap_caps_malloc(frame_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    ESP_RETURN_ON_FALSE(frame, ESP_ERR_NO_MEM, TAG, "No memory for benchmark frame");
+
+    // Horizontal stripes so tearing or dropped chunks are visible on the panel
+    for (int y = 0; y < VGC_LCD_V_RES; y++)
+    {
+        for (int x = 0; x < VGC_LCD_H_RES; x++)
+        {
+            frame[y * VGC_LCD_H_RES + x] = (y / 8) % 2 ? 0xFFFF : (uint16_t)(x * 0x0101);
+        }
+    }
+
+    esp_err_t ret = ESP_OK;
+    vgc_lcd_profile_t best = vgc_lcd_default_profile;
+    float best_fps = 0;
+
+    ESP_LOGI(TAG, "Benchmark: %d frames of %dx%d per profile", VGC_LCD_BENCHMARK_FRAMES, VGC_LCD_H_RES, VGC_LCD_V_RES);
+
+    for (int c = 0; c < sizeof(clocks) / sizeof(clocks[0]); c++)
+    {
+        for (int l = 0; l < sizeof(lines) / sizeof(lines[0]); l++)
+        {
+            for (int d = 0; d < sizeof(depths) / sizeof(depths[0]); d++)
+            {
+                const vgc_lcd_profile_t profile = {
+                    .pclk_hz = clocks[c],
+                    .trans_queue_depth = depths[d],
+                    .transfer_lines = lines[l],
+                };
+
+                ESP_GOTO_ON_ERROR(vgc_lcd_teardown(), restore, TAG, "Teardown failed");
+                ESP_GOTO_ON_ERROR(vgc_lcd_setup(&profile), restore, TAG, "Setup failed");
+
+                // Whole frames, so shorter transfer lines turn into a chain of transactions
+                int64_t start = esp_timer_get_time();
+                for (int i = 0; i < VGC_LCD_BENCHMARK_FRAMES; i++)
+                {
+                    esp_lcd_panel_draw_bitmap(vgc_lcd_panel_handle, 0, 0, VGC_LCD_H_RES, VGC_LCD_V_RES, frame);
+                }
+                vgc_lcd_wait_idle();
+                int64_t elapsed = esp_timer_get_time() - start;
+
+                float mb_per_s = (float)(frame_size * VGC_LCD_BENCHMARK_FRAMES) / elapsed;
+                float fps = VGC_LCD_BENCHMARK_FRAMES * 1000000.0f / elapsed;
+
+                ESP_LOGI(TAG, "%5.2f MHz, %3d lines, queue %2d: %5.2f MB/s, %6.1f fps",
+                         profile.pclk_hz / 1000000.0f, profile.transfer_lines, (int)profile.trans_queue_depth, mb_per_s, fps);
+
+                if (fps > best_fps)
+                {
+                    best_fps = fps;
+                    best = profile;
+                }
+            }
+        }
+    }
+
+    ESP_LOGI(TAG, "Fastest: %5.2f MHz, %3d lines, queue %2d at %.1f fps",
+             best.pclk_hz / 1000000.0f, best.transfer_lines, (int)best.trans_queue_depth, best_fps);
+
+restore:
+    heap_caps_free(frame);
+
+    // Back to the configured profile
+    if (vgc_lcd_panel_handle)
+    {
+        vgc_lcd_teardown();
+    }
+    ESP_RETURN_ON_ERROR(vgc_lcd_setup(&vgc_lcd_default_profile), TAG, "LCD setup failed");
+    vgc_lcd_clear();
+
+    return ret;
 }
 
 esp_err_t vgc_lvgl_deinit()
 {
-    return lvgl_port_remove_disp(vgc_display);
+    lv_display_t *display = vgc_display;
+    vgc_display = NULL;
+    return lvgl_port_remove_disp(display);
 }
\ No newline at end of file
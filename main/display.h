@@ -18,6 +18,8 @@
 #define VGC_LCD_BITS_PER_PIXEL (16)
 #define VGC_LCD_DRAW_BUFF_DOUBLE (1)
 #define VGC_LCD_DRAW_BUFF_HEIGHT (50)
+#define VGC_LCD_TRANS_QUEUE_DEPTH (10)
+#define VGC_LCD_TRANSFER_LINES (VGC_LCD_V_RES) /* Lines per SPI transaction, V_RES sends a whole frame in one */
 #define VGC_LCD_BL_ON_LEVEL (1)
 
 /* LCD pins */
@@ -28,11 +30,25 @@
 #define VGC_LCD_GPIO_CS (GPIO_NUM_5)
 #define VGC_LCD_GPIO_BL (GPIO_NUM_25)
 
+/* SPI transport settings, see vgc_lcd_benchmark() */
+typedef struct
+{
+    uint32_t pclk_hz;
+    size_t trans_queue_depth;
+    uint16_t transfer_lines;
+} vgc_lcd_profile_t;
+
+/* Called from ISR context each time a color transfer to the panel is done */
+typedef bool (*vgc_lcd_trans_done_cb_t)(void *user_ctx);
+
 esp_err_t vgc_lcd_clear();
 
 esp_err_t vgc_lcd_init();
 esp_err_t vgc_lcd_deinit();
 esp_err_t vgc_lcd_draw_bitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t *bitmap);
+esp_err_t vgc_lcd_wait_idle();
+void vgc_lcd_set_trans_done_cb(vgc_lcd_trans_done_cb_t cb, void *user_ctx);
+esp_err_t vgc_lcd_benchmark();
 
 esp_err_t vgc_lvgl_init();
 esp_err_t vgc_lvgl_deinit();
@@ -0,0 +1,127 @@
+#include "lz.h"
+#include <string.h>
+
+#define LZ_WINDOW_MASK (LZ_WINDOW_SIZE - 1)
+
+_Static_assert((LZ_WINDOW_SIZE & LZ_WINDOW_MASK) == 0, "window size must be a power of two");
+
+void lz_decoder_init(lz_decoder_t *decoder, const uint8_t *src, size_t srcSize)
+{
+    decoder->src = src;
+    decoder->srcEnd = src + srcSize;
+    decoder->literals = src;
+    decoder->windowPos = 0;
+    decoder->literalsLeft = 0;
+    decoder->matchLeft = 0;
+    decoder->matchOffset = 0;
+    decoder->corrupt = false;
+}
+
+// A nibble of 15 continues in the following bytes, until one is below 255
+static bool read_length(lz_decoder_t *decoder, size_t *length)
+{
+    if (*length != 15) {
+        return true;
+    }
+
+    uint8_t extra;
+    do {
+        if (decoder->src == decoder->srcEnd) {
+            return false;
+        }
+        extra = *decoder->src++;
+        *length += extra;
+    } while (extra == 255);
+
+    return true;
+}
+
+// Parse the next sequence header: its literals stay where they are in the input, the cursor
+// moves on past the match that follows them
+static bool read_sequence(lz_decoder_t *decoder)
+{
+    uint8_t token = *decoder->src++;
+
+    decoder->literalsLeft = token >> 4;
+    if (!read_length(decoder, &decoder->literalsLeft) || decoder->literalsLeft > (size_t)(decoder->srcEnd - decoder->src)) {
+        return false;
+    }
+    decoder->literals = decoder->src;
+    decoder->src += decoder->literalsLeft;
+
+    // The last sequence ends with its literals
+    if (decoder->src == decoder->srcEnd) {
+        decoder->matchLeft = 0;
+        return true;
+    }
+
+    if (decoder->srcEnd - decoder->src < 2) {
+        return false;
+    }
+    decoder->matchOffset = decoder->src[0] | (decoder->src[1] << 8);
+    decoder->src += 2;
+
+    // Can't reach back past the window or before the start of the output
+    uint32_t available = decoder->windowPos + decoder->literalsLeft;
+    if (decoder->matchOffset == 0 || decoder->matchOffset > LZ_WINDOW_SIZE || decoder->matchOffset > available) {
+        return false;
+    }
+
+    decoder->matchLeft = token & 0x0F;
+    if (!read_length(decoder, &decoder->matchLeft)) {
+        return false;
+    }
+    decoder->matchLeft += LZ_MIN_MATCH;
+
+    return true;
+}
+
+static inline void put_byte(lz_decoder_t *decoder, uint8_t *dst, uint8_t value)
+{
+    decoder->window[decoder->windowPos++ & LZ_WINDOW_MASK] = value;
+    *dst = value;
+}
+
+int lz_decoder_read(lz_decoder_t *decoder, uint8_t *dst, size_t capacity)
+{
+    if (decoder->corrupt) {
+        return -1;
+    }
+
+    size_t written = 0;
+
+    while (written < capacity) {
+        if (decoder->literalsLeft > 0) {
+            size_t count = capacity - written < decoder->literalsLeft ? capacity - written : decoder->literalsLeft;
+            for (size_t i = 0; i < count; i++) {
+                put_byte(decoder, &dst[written + i], decoder->literals[i]);
+            }
+            decoder->literals += count;
+            decoder->literalsLeft -= count;
+            written += count;
+            continue;
+        }
+
+        if (decoder->matchLeft > 0) {
+            // Byte by byte, a match may overlap the bytes it produces
+            size_t count = capacity - written < decoder->matchLeft ? capacity - written : decoder->matchLeft;
+            for (size_t i = 0; i < count; i++) {
+                put_byte(decoder, &dst[written + i], decoder->window[(decoder->windowPos - decoder->matchOffset) & LZ_WINDOW_MASK]);
+            }
+            decoder->matchLeft -= count;
+            written += count;
+            continue;
+        }
+
+        if (decoder->src == decoder->srcEnd) {
+            break;
+        }
+
+        if (!read_sequence(decoder)) {
+            decoder->corrupt = true;
+            return -1;
+        }
+    }
+
+    return written;
+}
@@ -0,0 +1,33 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Streaming decoder for the LZ77 format written by utils/lz.py. Output comes out in chunks of
+   any size; back references are served from a window of the last LZ_WINDOW_SIZE bytes, so the
+   whole output never has to be in memory at once. */
+#define LZ_WINDOW_SIZE 4096
+#define LZ_MIN_MATCH 3
+
+typedef struct
+{
+    const uint8_t *src;
+    const uint8_t *srcEnd;
+    const uint8_t *literals;
+    uint8_t window[LZ_WINDOW_SIZE];
+    uint32_t windowPos;
+    size_t literalsLeft;
+    size_t matchLeft;
+    uint32_t matchOffset;
+    bool corrupt;
+} lz_decoder_t;
+
+void lz_decoder_init(lz_decoder_t *decoder, const uint8_t *src, size_t srcSize);
+
+/* Decode up to capacity bytes into dst. Returns the number of bytes written, 0 at the end
+   of the stream, or -1 if the stream is corrupt. */
+int lz_decoder_read(lz_decoder_t *decoder, uint8_t *dst, size_t capacity);
+
+#endif // LZ_H
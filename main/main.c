@@ -1,4 +1,5 @@
 #include "fs.h"
+#include "assets.h"
 #include "display.h"
 #include "bitsybox/bitsybox.h"
 #include "esp_err.h"
@@ -12,8 +13,12 @@ void app_main(void)
     // Init FS
     ESP_ERROR_CHECK(vgc_fs_init());
 
+    // Map the packed assets
+    ESP_ERROR_CHECK(vgc_assets_init());
+
     /* LCD HW initialization */
     ESP_ERROR_CHECK(vgc_lcd_init());
+    //ESP_ERROR_CHECK(vgc_lcd_benchmark());
 
     /* LVGL initialization */
     ESP_ERROR_CHECK(vgc_lvgl_init());
@@ -27,6 +32,9 @@ void app_main(void)
     // Deinit LVGL
     ESP_ERROR_CHECK(vgc_lvgl_deinit());
 
+    // Unmap the packed assets
+    ESP_ERROR_CHECK(vgc_assets_deinit());
+
     // Deinit FS
     ESP_ERROR_CHECK(vgc_fs_deinit());
 }
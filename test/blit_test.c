@@ -0,0 +1,181 @@
+// Host test for the blit kernels: every kernel is run over random sizes, strides, alignments and
+// scales and compared bit for bit with a plain per-pixel loop, guard pixels included.
+#include "bitsybox.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_SIZE 8192
+#define GUARD 16
+#define ITERATIONS 2000
+
+// The kernels never read it, the header only declares it
+bitsy_color_t systemPalette[SYSTEM_PALETTE_MAX];
+
+static bitsy_pixel_t srcBuffer[BUFFER_SIZE];
+static bitsy_pixel_t dstBuffer[BUFFER_SIZE];
+static bitsy_pixel_t refBuffer[BUFFER_SIZE];
+
+static int failureCount = 0;
+
+static int random_int(int low, int high)
+{
+    return low + rand() % (high - low + 1);
+}
+
+static void fill_random(bitsy_pixel_t *buffer, int count)
+{
+    for (int i = 0; i < count; i++) {
+        buffer[i] = (bitsy_pixel_t)rand();
+    }
+}
+
+// Same random background in both destinations
+static void reset_destinations(void)
+{
+    fill_random(dstBuffer, BUFFER_SIZE);
+    memcpy(refBuffer, dstBuffer, sizeof(dstBuffer));
+}
+
+static void check(const char *kernel, int iteration)
+{
+    if (memcmp(dstBuffer, refBuffer, sizeof(dstBuffer)) == 0) {
+        return;
+    }
+
+    for (int i = 0; i < BUFFER_SIZE; i++) {
+        if (dstBuffer[i] != refBuffer[i]) {
+            printf("%s: iteration %d differs at pixel %d (%u, expected %u)\n", kernel, iteration, i,
+                   (unsigned)dstBuffer[i], (unsigned)refBuffer[i]);
+            break;
+        }
+    }
+    failureCount++;
+}
+
+static void ref_fill_rect(bitsy_pixel_t *dst, int dstStride, bitsy_pixel_t value, int w, int h)
+{
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            dst[y * dstStride + x] = value;
+        }
+    }
+}
+
+static void ref_copy_rect(bitsy_pixel_t *dst, int dstStride, const bitsy_pixel_t *src, int srcStride,
+                          const uint8_t *rowMasks, int w, int h, int scale)
+{
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (rowMasks != NULL && (rowMasks[y] & (1u << x)) == 0) {
+                continue;
+            }
+            ref_fill_rect(&dst[y * scale * dstStride + x * scale], dstStride, src[y * srcStride + x], scale, scale);
+        }
+    }
+}
+
+static void test_fill(void)
+{
+    for (int i = 0; i < ITERATIONS; i++) {
+        int offset = GUARD + random_int(0, 7);
+        int count = random_int(0, 300);
+        bitsy_pixel_t value = (bitsy_pixel_t)rand();
+
+        reset_destinations();
+        blit_fill(&dstBuffer[offset], value, count);
+        ref_fill_rect(&refBuffer[offset], count, value, count, 1);
+        check("blit_fill", i);
+    }
+}
+
+static void test_copy_row(void)
+{
+    for (int i = 0; i < ITERATIONS; i++) {
+        int dstOffset = GUARD + random_int(0, 7);
+        int srcOffset = random_int(0, 7);
+        int count = random_int(0, 300);
+
+        fill_random(srcBuffer, BUFFER_SIZE);
+        reset_destinations();
+        blit_copy_row(&dstBuffer[dstOffset], &srcBuffer[srcOffset], count);
+        ref_copy_rect(&refBuffer[dstOffset], count, &srcBuffer[srcOffset], count, NULL, count, 1, 1);
+        check("blit_copy_row", i);
+    }
+}
+
+static void test_fill_rect(void)
+{
+    for (int i = 0; i < ITERATIONS; i++) {
+        int offset = GUARD + random_int(0, 7);
+        int w = random_int(0, 40);
+        int h = random_int(0, 40);
+        int stride = w + random_int(0, 9);
+        bitsy_pixel_t value = (bitsy_pixel_t)rand();
+
+        reset_destinations();
+        blit_fill_rect(&dstBuffer[offset], stride, value, w, h);
+        ref_fill_rect(&refBuffer[offset], stride, value, w, h);
+        check("blit_fill_rect", i);
+    }
+}
+
+// blit_copy_rect picks the 1x, 2x or nx kernel from the scale
+static void test_copy_rect(void)
+{
+    for (int i = 0; i < ITERATIONS; i++) {
+        int scale = random_int(1, 4);
+        int w = random_int(0, 24);
+        int h = random_int(0, 12);
+        int srcStride = w + random_int(0, 9);
+        int dstStride = w * scale + random_int(0, 9);
+        int dstOffset = GUARD + random_int(0, 7);
+        int srcOffset = random_int(0, 7);
+
+        fill_random(srcBuffer, BUFFER_SIZE);
+        reset_destinations();
+        blit_copy_rect(&dstBuffer[dstOffset], dstStride, &srcBuffer[srcOffset], srcStride, w, h, scale);
+        ref_copy_rect(&refBuffer[dstOffset], dstStride, &srcBuffer[srcOffset], srcStride, NULL, w, h, scale);
+        check(scale == 1 ? "blit_copy_rect_1x" : scale == 2 ? "blit_copy_rect_2x" : "blit_copy_rect_nx", i);
+    }
+}
+
+static void test_copy_rect_masked(void)
+{
+    uint8_t rowMasks[TILE_SIZE];
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        int scale = random_int(1, 3);
+        int w = random_int(0, TILE_SIZE);
+        int h = random_int(0, TILE_SIZE);
+        int srcStride = w + random_int(0, 9);
+        int dstStride = w * scale + random_int(0, 9);
+        int dstOffset = GUARD + random_int(0, 7);
+        int srcOffset = random_int(0, 7);
+
+        // Mix empty, full and partial rows
+        for (int y = 0; y < TILE_SIZE; y++) {
+            int kind = random_int(0, 3);
+            rowMasks[y] = kind == 0 ? 0x00 : kind == 1 ? 0xFF : (uint8_t)rand();
+        }
+
+        fill_random(srcBuffer, BUFFER_SIZE);
+        reset_destinations();
+        blit_copy_rect_masked(&dstBuffer[dstOffset], dstStride, &srcBuffer[srcOffset], srcStride, rowMasks, w, h, scale);
+        ref_copy_rect(&refBuffer[dstOffset], dstStride, &srcBuffer[srcOffset], srcStride, rowMasks, w, h, scale);
+        check("blit_copy_rect_masked", i);
+    }
+}
+
+int main(void)
+{
+    srand(1);
+
+    test_fill();
+    test_copy_row();
+    test_fill_rect();
+    test_copy_rect();
+    test_copy_rect_masked();
+
+    printf("blit (%s pixels): %s\n", INDEXED_FRAMEBUFFER ? "indexed" : "RGB565", failureCount ? "FAILED" : "ok");
+    return failureCount ? 1 : 0;
+}
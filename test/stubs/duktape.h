@@ -0,0 +1,6 @@
+#pragma once
+// Host stand-in: only the types the bitsybox declarations need
+#include <stddef.h>
+typedef struct duk_hthread duk_context;
+typedef int duk_ret_t;
+typedef size_t duk_size_t;
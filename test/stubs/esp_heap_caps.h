@@ -0,0 +1,10 @@
+#pragma once
+// Host stand-in: every capability is plain malloc
+#include <stdlib.h>
+#include <string.h>
+#define MALLOC_CAP_SPIRAM 0
+#define MALLOC_CAP_INTERNAL 0
+#define MALLOC_CAP_8BIT 0
+#define heap_caps_malloc(size, caps) malloc(size)
+#define heap_caps_realloc(ptr, size, caps) realloc(ptr, size)
+#define heap_caps_free(ptr) free(ptr)
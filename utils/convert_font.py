@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Convert a .bitsyfont text font into the binary font format loaded by bitsybox.
+
+Layout, little endian:
+  header (32 bytes)
+    char[4]  magic "BFNT"
+    u8       version (1)
+    u8       default glyph width
+    u8       default glyph height
+    u8       reserved
+    u16      glyph count
+    u16      reserved
+    u32      size of the bitmap block in bytes
+    char[16] font name, NUL padded
+  glyph index (16 bytes per glyph, sorted by char code)
+    u32      char code
+    u32      offset of the glyph bitmap in the bitmap block
+    u8       width
+    u8       height
+    i8       x offset
+    i8       y offset
+    u8       spacing
+    u8[3]    reserved
+  bitmap block
+    1 bit per pixel, rows padded to whole bytes, most significant bit first
+
+Usage: convert_font.py input.bitsyfont output.bfnt
+"""
+
+import struct
+import sys
+
+MAGIC = b"BFNT"
+VERSION = 1
+NAME_SIZE = 16
+
+
+def parse_bitsyfont(text):
+    name = ""
+    width, height = 6, 8
+    glyphs = []
+    glyph = None
+
+    for line in text.splitlines():
+        line = line.strip()
+        parts = line.split()
+        if not parts:
+            continue
+
+        if parts[0] == "FONT":
+            name = " ".join(parts[1:])
+        elif parts[0] == "SIZE":
+            width, height = int(parts[1]), int(parts[2])
+        elif parts[0] == "CHAR":
+            glyph = {
+                "code": int(parts[1]),
+                "width": width,
+                "height": height,
+                "offset": (0, 0),
+                "spacing": None,
+                "rows": [],
+            }
+            glyphs.append(glyph)
+        elif glyph is not None and parts[0] == "CHAR_SIZE":
+            glyph["width"], glyph["height"] = int(parts[1]), int(parts[2])
+        elif glyph is not None and parts[0] == "CHAR_OFFSET":
+            glyph["offset"] = (int(parts[1]), int(parts[2]))
+        elif glyph is not None and parts[0] == "CHAR_SPACING":
+            glyph["spacing"] = int(parts[1])
+        elif glyph is not None and set(line) <= {"0", "1"} and len(glyph["rows"]) < glyph["height"]:
+            glyph["rows"].append(line)
+
+    return name, width, height, glyphs
+
+
+def pack_rows(rows, width, height):
+    row_bytes = (width + 7) // 8
+    data = bytearray()
+    for y in range(height):
+        row = rows[y] if y < len(rows) else ""
+        packed = bytearray(row_bytes)
+        for x in range(min(width, len(row))):
+            if row[x] == "1":
+                packed[x // 8] |= 0x80 >> (x % 8)
+        data += packed
+    return bytes(data)
+
+
+def convert(text):
+    name, width, height, glyphs = parse_bitsyfont(text)
+
+    # Later definitions of a char code win, like in the engine
+    by_code = {glyph["code"]: glyph for glyph in glyphs}
+
+    index = bytearray()
+    bitmaps = bytearray()
+    for code in sorted(by_code):
+        glyph = by_code[code]
+        spacing = glyph["spacing"] if glyph["spacing"] is not None else glyph["width"]
+        index += struct.pack("<IIBBbbB3x", code, len(bitmaps), glyph["width"], glyph["height"],
+                             glyph["offset"][0], glyph["offset"][1], spacing)
+        bitmaps += pack_rows(glyph["rows"], glyph["width"], glyph["height"])
+
+    header = struct.pack("<4sBBBxHxxI16s", MAGIC, VERSION, width, height, len(by_code), len(bitmaps),
+                         name.encode("utf-8")[:NAME_SIZE - 1])
+    return header + index + bitmaps
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__.strip().splitlines()[-1])
+        sys.exit(1)
+
+    with open(sys.argv[1], "r", encoding="utf-8") as f:
+        data = convert(f.read())
+
+    with open(sys.argv[2], "wb") as f:
+        f.write(data)
+
+    print("%s: %d bytes" % (sys.argv[2], len(data)))
+
+
+if __name__ == "__main__":
+    main()
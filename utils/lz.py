@@ -0,0 +1,110 @@
+"""Small LZ77 codec for packed assets, decoded on the device by main/lz.c.
+
+A stream is a series of sequences, each:
+  token     u8, high nibble literal count, low nibble match length - LZ_MIN_MATCH
+  [length]  when a nibble is 15, extra bytes are added to it until one is below 255
+  literals
+  offset    u16 little endian, 1..LZ_WINDOW_SIZE back from the current output position
+  [length]  extra match length bytes, as above
+The last sequence stops after its literals, the stream ends with the input.
+"""
+
+LZ_WINDOW_SIZE = 4096
+LZ_MIN_MATCH = 3
+LZ_MAX_CHAIN = 64
+
+
+def _put_length(out, length):
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+
+def _put_sequence(out, literals, match_length, offset):
+    literal_count = len(literals)
+    match_code = match_length - LZ_MIN_MATCH if match_length else 0
+
+    out.append((min(literal_count, 15) << 4) | min(match_code, 15))
+    if literal_count >= 15:
+        _put_length(out, literal_count - 15)
+    out += literals
+
+    if match_length:
+        out += bytes((offset & 0xFF, offset >> 8))
+        if match_code >= 15:
+            _put_length(out, match_code - 15)
+
+
+def compress(data):
+    out = bytearray()
+    chains = {}
+    literal_start = 0
+    i = 0
+
+    while i + LZ_MIN_MATCH <= len(data):
+        key = data[i:i + LZ_MIN_MATCH]
+        candidates = chains.setdefault(key, [])
+
+        best_length = 0
+        best_offset = 0
+        for position in reversed(candidates[-LZ_MAX_CHAIN:]):
+            if i - position > LZ_WINDOW_SIZE:
+                break
+            length = LZ_MIN_MATCH
+            while i + length < len(data) and data[position + length] == data[i + length]:
+                length += 1
+            if length > best_length:
+                best_length = length
+                best_offset = i - position
+
+        candidates.append(i)
+
+        if best_length < LZ_MIN_MATCH:
+            i += 1
+            continue
+
+        _put_sequence(out, data[literal_start:i], best_length, best_offset)
+        for position in range(i + 1, min(i + best_length, len(data) - LZ_MIN_MATCH + 1)):
+            chains.setdefault(data[position:position + LZ_MIN_MATCH], []).append(position)
+        i += best_length
+        literal_start = i
+
+    _put_sequence(out, data[literal_start:], 0, 0)
+    return bytes(out)
+
+
+def _get_length(data, i, length):
+    if length == 15:
+        while True:
+            extra = data[i]
+            i += 1
+            length += extra
+            if extra != 255:
+                break
+    return length, i
+
+
+def decompress(data):
+    out = bytearray()
+    i = 0
+
+    while i < len(data):
+        token = data[i]
+        i += 1
+
+        literal_count, i = _get_length(data, i, token >> 4)
+        out += data[i:i + literal_count]
+        i += literal_count
+        if i >= len(data):
+            break
+
+        offset = data[i] | (data[i + 1] << 8)
+        i += 2
+        match_length, i = _get_length(data, i, token & 0x0F)
+        match_length += LZ_MIN_MATCH
+
+        for _ in range(match_length):
+            out.append(out[-offset])
+
+    return bytes(out)
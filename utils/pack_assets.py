@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Pack a directory of assets into one indexed image for the read-only assets partition.
+
+The firmware maps the partition and looks files up by their path relative to the packed
+directory (e.g. "engine/bitsy.bin"), reading them in place.
+
+Layout, little endian:
+  header (16 bytes)
+    char[4]  magic "BPAK"
+    u16      version (1)
+    u16      entry count
+    u32      offset of the first file
+    u32      total image size
+  index (64 bytes per entry, sorted by path)
+    char[48] path, NUL padded
+    u32      offset of the file in the image
+    u32      size of the file as stored
+    u32      flags, ASSET_FLAG_LZ when stored compressed with utils/lz.py
+    u32      size of the file once decompressed
+  files, each starting on an ALIGNMENT boundary
+
+Usage: pack_assets.py [--compress .ext,.ext] input_dir output.bin [partition_size]
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+import lz
+
+MAGIC = b"BPAK"
+VERSION = 1
+HEADER_FORMAT = "<4sHHII"
+ENTRY_FORMAT = "<48sIIII"
+PATH_SIZE = 48
+ALIGNMENT = 16
+ASSET_FLAG_LZ = 1
+
+
+def align(value):
+    return (value + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+
+
+def collect_files(root):
+    files = []
+    for directory, _, names in os.walk(root):
+        for name in names:
+            path = os.path.join(directory, name)
+            files.append((os.path.relpath(path, root).replace(os.sep, "/"), path))
+    # The firmware binary searches the index with strcmp
+    return sorted(files, key=lambda f: f[0].encode("utf-8"))
+
+
+def pack(root, compress_extensions):
+    files = collect_files(root)
+
+    index = bytearray()
+    data = bytearray()
+    data_offset = align(struct.calcsize(HEADER_FORMAT) + len(files) * struct.calcsize(ENTRY_FORMAT))
+    report = []
+
+    for name, path in files:
+        encoded = name.encode("utf-8")
+        if len(encoded) >= PATH_SIZE:
+            raise ValueError("asset path too long: %s" % name)
+
+        with open(path, "rb") as f:
+            content = f.read()
+
+        stored = content
+        flags = 0
+        if os.path.splitext(name)[1] in compress_extensions:
+            compressed = lz.compress(content)
+            if lz.decompress(compressed) != content:
+                raise ValueError("compression round trip failed: %s" % name)
+            # Only worth it when it saves flash
+            if len(compressed) < len(content):
+                stored = compressed
+                flags = ASSET_FLAG_LZ
+
+        data += bytes(align(len(data)) - len(data))
+        index += struct.pack(ENTRY_FORMAT, encoded, data_offset + len(data), len(stored), flags, len(content))
+        data += stored
+        report.append((name, len(content), len(stored)))
+
+    header_and_index = struct.pack(HEADER_FORMAT, MAGIC, VERSION, len(files), data_offset, data_offset + len(data))
+    header_and_index += index
+    header_and_index += bytes(data_offset - len(header_and_index))
+
+    return header_and_index + data, report
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack a directory of assets for the assets partition")
+    parser.add_argument("--compress", default="", help="comma separated file extensions to store compressed")
+    parser.add_argument("input_dir")
+    parser.add_argument("output")
+    parser.add_argument("partition_size", nargs="?")
+    args = parser.parse_args()
+
+    compress_extensions = [ext for ext in args.compress.split(",") if ext]
+    image, report = pack(args.input_dir, compress_extensions)
+
+    for name, size, stored in report:
+        print("  %-48s %7d -> %7d bytes" % (name, size, stored))
+
+    if args.partition_size is not None and len(image) > int(args.partition_size, 0):
+        print("Assets need %d bytes, the partition only has %s" % (len(image), args.partition_size))
+        sys.exit(1)
+
+    with open(args.output, "wb") as f:
+        f.write(image)
+
+    print("%s: %d files, %d bytes (%d bytes uncompressed)" % (args.output, len(report), len(image),
+                                                             sum(size for _, size, _ in report)))
+
+
+if __name__ == "__main__":
+    main()